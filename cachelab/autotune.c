@@ -0,0 +1,262 @@
+/*
+ * autotune.c - Find the best tiling of the transpose for a cache geometry
+ *
+ * A family of transpose variants is described by a few parameters: the
+ * height and width of the blocks of A that are transposed at a time, and
+ * how each row of a block is moved:
+ *
+ *   blocked   load A[i][j] and store B[j][i] element by element
+ *   deferred  the same, but the element on the diagonal is stored after
+ *             the rest of the row, since on the diagonal the rows of A
+ *             and B map to the same sets
+ *   buffered  load the whole row of the block into locals, then store
+ *             it; the row must fit in the 12 locals the lab allows,
+ *             minus the loop variables
+ *
+ * Instead of compiling each variant, autotune generates the accesses it
+ * would make and feeds them to the cache model of cachesim.c, so every
+ * variant for every block size can be scored in seconds. Locals are
+ * registers and make no accesses, as in the traces of test-trans.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <getopt.h>
+#include "cachesim.h"
+
+/* Largest matrix of test-trans, whose A and B are MAXN x MAXN arrays */
+#define MAXN 256
+
+/* Largest block side tried, besides the whole matrix */
+#define MAX_BLOCK 32
+
+/* Longest row a buffered variant may hold in locals */
+#define MAX_BUFFER 8
+
+enum { BLOCKED, DEFERRED, BUFFERED, MODES };
+static const char *mode_names[MODES] = {"blocked", "deferred", "buffered"};
+
+typedef struct variant {
+    int mode;
+    int bh, bw;                 /* Block height (rows of A) and width */
+    unsigned long misses;
+} variant_t;
+
+/* Globals set on the command line */
+static unsigned long abase = 0;
+static unsigned long bbase = MAXN * MAXN * sizeof(int);
+
+#define ADDR_A(i, j) (abase + ((unsigned long)(i) * M + (j)) * sizeof(int))
+#define ADDR_B(j, i) (bbase + ((unsigned long)(j) * N + (i)) * sizeof(int))
+
+/* Simulate variant v transposing the N x M matrix A into B */
+static unsigned long score(cache_t *cache, int M, int N, const variant_t *v)
+{
+    cache_stats_t stats;
+    int bi, bj, i, j, iend, jend;
+
+    cacheReset(cache);
+    for (bi = 0; bi < N; bi += v->bh) {
+        iend = bi + v->bh < N ? bi + v->bh : N;
+        for (bj = 0; bj < M; bj += v->bw) {
+            jend = bj + v->bw < M ? bj + v->bw : M;
+            for (i = bi; i < iend; i++) {
+                switch (v->mode) {
+                case BLOCKED:
+                    for (j = bj; j < jend; j++) {
+                        cacheAccess(cache, 'L', ADDR_A(i, j), sizeof(int));
+                        cacheAccess(cache, 'S', ADDR_B(j, i), sizeof(int));
+                    }
+                    break;
+                case DEFERRED:
+                    for (j = bj; j < jend; j++) {
+                        cacheAccess(cache, 'L', ADDR_A(i, j), sizeof(int));
+                        if (i != j)
+                            cacheAccess(cache, 'S', ADDR_B(j, i), sizeof(int));
+                    }
+                    if (i >= bj && i < jend)
+                        cacheAccess(cache, 'S', ADDR_B(i, i), sizeof(int));
+                    break;
+                case BUFFERED:
+                    for (j = bj; j < jend; j++)
+                        cacheAccess(cache, 'L', ADDR_A(i, j), sizeof(int));
+                    for (j = bj; j < jend; j++)
+                        cacheAccess(cache, 'S', ADDR_B(j, i), sizeof(int));
+                    break;
+                }
+            }
+        }
+    }
+    cacheStats(cache, &stats);
+    return stats.misses;
+}
+
+/* Better variants come first: fewer misses, then larger blocks */
+static int compare(const void *x, const void *y)
+{
+    const variant_t *a = x, *b = y;
+
+    if (a->misses != b->misses)
+        return a->misses < b->misses ? -1 : 1;
+    if (a->bh * a->bw != b->bh * b->bw)
+        return b->bh * b->bw - a->bh * a->bw;
+    return a->mode - b->mode;
+}
+
+/* Score every variant for an N x M matrix, sorted best first */
+static variant_t *tune(cache_t *cache, int M, int N, int *count)
+{
+    int maxh = N < MAX_BLOCK ? N : MAX_BLOCK;
+    int maxw = M < MAX_BLOCK ? M : MAX_BLOCK;
+    variant_t *vs = malloc(MODES * (maxh + 1) * (maxw + 1) * sizeof(variant_t));
+    int n = 0, mode, h, w;
+
+    for (mode = 0; mode < MODES; mode++) {
+        for (h = 1; h <= maxh + 1; h++) {
+            for (w = 1; w <= maxw + 1; w++) {
+                variant_t *v = &vs[n];
+
+                /* One past the largest block side stands for the whole matrix */
+                v->bh = h > maxh ? N : h;
+                v->bw = w > maxw ? M : w;
+                if ((h > maxh && maxh == N) || (w > maxw && maxw == M))
+                    continue;
+                if (mode == BUFFERED && v->bw > MAX_BUFFER)
+                    continue;
+                v->mode = mode;
+                v->misses = score(cache, M, N, v);
+                n++;
+            }
+        }
+    }
+    qsort(vs, n, sizeof(variant_t), compare);
+    *count = n;
+    return vs;
+}
+
+/* Read the addresses of A and B from a region file written by tracegen */
+static int load_regions(const char *file)
+{
+    FILE *fp = fopen(file, "r");
+    char line[256], name[64];
+    unsigned long base;
+    int found = 0;
+
+    if (fp == NULL) {
+        printf("Unable to open region file \"%s\"\n", file);
+        return 0;
+    }
+    while (fgets(line, sizeof(line), fp)) {
+        if (sscanf(line, "%63s %lx", name, &base) != 2 || name[0] == '#')
+            continue;
+        if (strcmp(name, "A") == 0) {
+            abase = base;
+            found |= 1;
+        } else if (strcmp(name, "B") == 0) {
+            bbase = base;
+            found |= 2;
+        }
+    }
+    fclose(fp);
+    if (found != 3) {
+        printf("Region file \"%s\" lacks A or B\n", file);
+        return 0;
+    }
+    return 1;
+}
+
+static void usage(char *argv[])
+{
+    printf("Usage: %s [-h] -s <s> -E <E> -b <b> [-p <policy>] [-r <regionfile>] "
+           "[-k <top>] [<M>x<N> ...]\n", argv[0]);
+    printf("Options:\n");
+    printf("  -h             Print this help message.\n");
+    printf("  -s <s>         Number of set index bits.\n");
+    printf("  -E <E>         Number of lines per set.\n");
+    printf("  -b <b>         Number of block offset bits.\n");
+    printf("  -p <policy>    Replacement policy (default: lru).\n");
+    printf("  -r <regionfile> Take the addresses of A and B from tracegen's\n"
+           "                 .regions (default: A at 0, B right after it).\n");
+    printf("  -k <top>       Print the best <top> variants of each size.\n");
+    printf("The sizes default to 32x32, 64x64 and 61x67, where M is the\n"
+           "number of columns of A, as in test-trans.\n");
+    printf("Example: %s -s 5 -E 1 -b 5 -k 5 64x64\n", argv[0]);
+}
+
+int main(int argc, char *argv[])
+{
+    static char *defaults[] = {"32x32", "64x64", "61x67"};
+    char **sizes = defaults;
+    int nsizes = 3;
+    int s = -1, E = 0, b = -1, top = 1;
+    char *policy = NULL;
+    cache_t *cache;
+    int c, k;
+
+    while ((c = getopt(argc, argv, "hs:E:b:p:r:k:")) != -1) {
+        switch (c) {
+        case 's':
+            s = atoi(optarg);
+            break;
+        case 'E':
+            E = atoi(optarg);
+            break;
+        case 'b':
+            b = atoi(optarg);
+            break;
+        case 'p':
+            policy = optarg;
+            break;
+        case 'r':
+            if (!load_regions(optarg))
+                exit(1);
+            break;
+        case 'k':
+            top = atoi(optarg);
+            break;
+        case 'h':
+            usage(argv);
+            exit(0);
+        default:
+            usage(argv);
+            exit(1);
+        }
+    }
+    if (s < 0 || E <= 0 || b < 0 || top <= 0) {
+        usage(argv);
+        exit(1);
+    }
+    if (optind < argc) {
+        sizes = argv + optind;
+        nsizes = argc - optind;
+    }
+    cache = cacheCreate(s, E, b, policy);
+    if (cache == NULL) {
+        printf("Unknown policy \"%s\" or unsupported E\n", policy);
+        exit(1);
+    }
+
+    printf("# s=%d E=%d b=%d policy=%s\n", s, E, b, policy ? policy : "lru");
+    printf("# %-7s %-9s %6s %6s %8s\n", "MxN", "variant", "rows", "cols",
+           "misses");
+    for (k = 0; k < nsizes; k++) {
+        int M, N, count, i;
+        variant_t *vs;
+
+        if (sscanf(sizes[k], "%dx%d", &M, &N) != 2 || M <= 0 || N <= 0 ||
+            M > MAXN || N > MAXN) {
+            printf("Invalid size \"%s\", expected <M>x<N> up to %dx%d\n",
+                   sizes[k], MAXN, MAXN);
+            exit(1);
+        }
+        vs = tune(cache, M, N, &count);
+        for (i = 0; i < top && i < count; i++) {
+            printf("%3dx%-5d %-9s %6d %6d %8lu\n", M, N,
+                   mode_names[vs[i].mode], vs[i].bh, vs[i].bw, vs[i].misses);
+        }
+        free(vs);
+    }
+    cacheFree(cache);
+    return 0;
+}
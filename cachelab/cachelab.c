@@ -82,3 +82,173 @@ void registerTransFunction(void (*trans)(int M, int N, int[N][M], int[M][N]),
     func_list[func_counter].num_evictions =0;
     func_counter++;
 }
+
+/*
+ * Kernel registry
+ */
+kernel_t kernel_list[MAX_KERNELS];
+int kernel_counter = 0;
+
+static const char *kernel_family_names[NUM_KERNEL_FAMILIES] = {
+    "gemm", "stencil", "scan", "gather", "scatter"
+};
+
+/* Seed of the inputs, fixed so that misses are reproducible */
+#define KERNEL_SEED 213
+
+/* 
+ * registerKernel - Add the given kernel into the list of kernels to be
+ *     tested
+ */
+void registerKernel(int family, void (*kernel)(const kernel_args_t *args),
+                    char *desc)
+{
+    assert(kernel_counter < MAX_KERNELS);
+    kernel_list[kernel_counter].family = family;
+    kernel_list[kernel_counter].func_ptr = kernel;
+    kernel_list[kernel_counter].description = desc;
+    kernel_counter++;
+}
+
+const char *kernelFamilyName(int family)
+{
+    return kernel_family_names[family];
+}
+
+kernel_args_t *kernelArgsCreate(int family, int n)
+{
+    kernel_args_t *args = calloc(1, sizeof(kernel_args_t));
+    size_t i, len = (size_t) n * n;
+
+    assert(args);
+    args->n = n;
+    srand(KERNEL_SEED);
+    switch (family) {
+    case KERNEL_GEMM:
+    case KERNEL_STENCIL:
+        args->a = malloc(len * sizeof(double));
+        args->b = calloc(len, sizeof(double));
+        args->c = calloc(len, sizeof(double));
+        assert(args->a && args->b && args->c);
+        /* Small integers, so that every order of summation is exact */
+        for (i = 0; i < len; i++) {
+            args->a[i] = rand() % 16;
+            args->b[i] = family == KERNEL_GEMM ? rand() % 16 : 0;
+        }
+        break;
+    case KERNEL_SCAN:
+        args->x = malloc(len * sizeof(long));
+        args->y = calloc(len, sizeof(long));
+        assert(args->x && args->y);
+        for (i = 0; i < len; i++)
+            args->x[i] = rand() % 1000;
+        break;
+    case KERNEL_GATHER:
+    case KERNEL_SCATTER:
+        args->a = malloc(len * sizeof(double));
+        args->c = calloc(len, sizeof(double));
+        args->idx = malloc(len * sizeof(int));
+        assert(args->a && args->c && args->idx);
+        for (i = 0; i < len; i++) {
+            args->a[i] = rand();
+            args->idx[i] = i;
+        }
+        /* Fisher-Yates shuffle */
+        for (i = len; i > 1; i--) {
+            size_t j = (size_t) rand() % i;
+            int tmp = args->idx[i - 1];
+            args->idx[i - 1] = args->idx[j];
+            args->idx[j] = tmp;
+        }
+        break;
+    }
+    return args;
+}
+
+void kernelArgsClear(int family, kernel_args_t *args)
+{
+    size_t i, len = (size_t) args->n * args->n;
+
+    for (i = 0; i < len; i++) {
+        if (family == KERNEL_GEMM || family == KERNEL_GATHER ||
+            family == KERNEL_SCATTER)
+            args->c[i] = 0;
+        else if (family == KERNEL_STENCIL)
+            args->b[i] = 0;
+        else
+            args->y[i] = 0;
+    }
+}
+
+void kernelArgsFree(kernel_args_t *args)
+{
+    free(args->a);
+    free(args->b);
+    free(args->c);
+    free(args->x);
+    free(args->y);
+    free(args->idx);
+    free(args);
+}
+
+/* Relative tolerance of the oracles for doubles */
+static int close_enough(double x, double y)
+{
+    double d = x > y ? x - y : y - x;
+    double m = y > 0 ? y : -y;
+
+    return d <= 1e-9 * (1 + m);
+}
+
+int kernelCheck(int family, const kernel_args_t *args)
+{
+    int n = args->n;
+    size_t i, len = (size_t) n * n;
+    int r, c, k;
+    long sum = 0;
+
+    switch (family) {
+    case KERNEL_GEMM:
+        for (r = 0; r < n; r++) {
+            for (c = 0; c < n; c++) {
+                double dot = 0;
+                for (k = 0; k < n; k++)
+                    dot += args->a[r * n + k] * args->b[k * n + c];
+                if (!close_enough(args->c[r * n + c], dot))
+                    return 0;
+            }
+        }
+        return 1;
+    case KERNEL_STENCIL:
+        for (r = 0; r < n; r++) {
+            for (c = 0; c < n; c++) {
+                const double *a = args->a + r * n + c;
+                double want = *a;
+                /* The boundary is copied */
+                if (r > 0 && r < n - 1 && c > 0 && c < n - 1)
+                    want = 0.2 * (a[0] + a[-1] + a[1] + a[-n] + a[n]);
+                if (!close_enough(args->b[r * n + c], want))
+                    return 0;
+            }
+        }
+        return 1;
+    case KERNEL_SCAN:
+        for (i = 0; i < len; i++) {
+            sum += args->x[i];
+            if (args->y[i] != sum)
+                return 0;
+        }
+        return 1;
+    case KERNEL_GATHER:
+        for (i = 0; i < len; i++)
+            if (args->c[i] != args->a[args->idx[i]])
+                return 0;
+        return 1;
+    case KERNEL_SCATTER:
+        for (i = 0; i < len; i++)
+            if (args->c[args->idx[i]] != args->a[i])
+                return 0;
+        return 1;
+    }
+    return 0;
+}
@@ -34,4 +34,67 @@ void correctTrans(int M, int N, int A[N][M], int B[M][N]);
 void registerTransFunction(void (*trans)(int M,int N,int[N][M],int[M][N]), 
                            char* desc);
 
+/*
+ * In-place transposes, defined in trans.c
+ */
+
+/* Transpose the n x n matrix C in place */
+void trans_square_inplace(int n, int C[n][n]);
+
+/* Transpose the rows x cols matrix in C in place into a cols x rows one,
+   returns 0 and leaves C as is if it is out of memory */
+int trans_rect_inplace(int rows, int cols, int *C);
+
+/*
+ * Kernel registry
+ *
+ * Other hot loops are registered the same way as transpose functions,
+ * as kernels of a family. All kernels of a family compute the same
+ * result from the same arguments, which the family's oracle checks.
+ */
+#define MAX_KERNELS 100
+
+enum {
+    KERNEL_GEMM,        /* c = a * b, n x n matrices */
+    KERNEL_STENCIL,     /* b = one 5-point Jacobi sweep over a, n x n */
+    KERNEL_SCAN,        /* y[i] = x[0] + ... + x[i], n * n elements */
+    KERNEL_GATHER,      /* c[i] = a[idx[i]], n * n elements */
+    KERNEL_SCATTER,     /* c[idx[i]] = a[i], n * n elements */
+    NUM_KERNEL_FAMILIES
+};
+
+/* The arguments of a kernel, the fields a family does not use are NULL */
+typedef struct kernel_args {
+    int n;
+    double *a, *b, *c;
+    long *x, *y;
+    int *idx;           /* A permutation of 0 .. n * n - 1 */
+} kernel_args_t;
+
+typedef struct kernel {
+    int family;
+    void (*func_ptr)(const kernel_args_t *args);
+    char *description;
+} kernel_t;
+
+/* Add the given kernel of family to the kernel list */
+void registerKernel(int family, void (*kernel)(const kernel_args_t *args),
+                    char *desc);
+
+/* Name of a family, such as "gemm" */
+const char *kernelFamilyName(int family);
+
+/* Allocate the arguments of family for size n, with the same random
+   inputs for the same family and n */
+kernel_args_t *kernelArgsCreate(int family, int n);
+
+/* Zero the outputs of a kernel of family */
+void kernelArgsClear(int family, kernel_args_t *args);
+
+/* Free the arguments */
+void kernelArgsFree(kernel_args_t *args);
+
+/* The oracle of family: returns 1 if the outputs in args are correct */
+int kernelCheck(int family, const kernel_args_t *args);
+
 #endif /* CACHELAB_TOOLS_H */
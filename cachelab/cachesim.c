@@ -0,0 +1,573 @@
+/*
+ * cachesim.c - Set-associative cache simulator with pluggable
+ *              replacement policies, see cachesim.h
+ *
+ * Author: Jieyu Lu
+ * Andrew ID: jieyul1
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "cachesim.h"
+
+// Maximum re-reference prediction value of the 2-bit RRIP policies
+#define RRPV_MAX 3
+// BRRIP inserts with a long (instead of distant) prediction once every 32 fills
+#define BRRIP_LONG_ODDS 32
+
+// Structor that simulates the behavior of a cache line
+typedef struct line_st {
+  int valid;
+  unsigned long tag;
+  unsigned long stamp;// Time of last use (LRU, LFU) or of fill (FIFO)
+  unsigned count;// Use count (LFU) or re-reference prediction value (RRIP)
+  int prefetched;// Filled by a prefetch and not demanded since
+  unsigned long ready;// Time at which a prefetched block arrives
+} Line;
+
+// A set holds its lines together with the per-set state of the policy
+typedef struct set_st {
+  Line * lines;
+  unsigned long plru;// Tree pseudo-LRU bits, bit k is internal node k (root is 1)
+  unsigned long seed;// Random state (Random, BRRIP)
+} Set;
+
+struct cache;
+struct prefetcher_st;
+
+// A replacement policy only decides which line to evict and how lines age.
+// touch() is called on a hit, fill() after a new block is placed in a line,
+// and victim() when all lines of the set are valid.
+typedef struct policy_st {
+  const char * name;
+  void (*touch)(struct cache * cache, Set * set, int way);
+  void (*fill)(struct cache * cache, Set * set, int way);
+  int (*victim)(struct cache * cache, Set * set);
+} Policy;
+
+typedef struct cache {
+  int s;// Number of set index bits
+  int E;// Number of lines per set
+  int b;// Number of block bits
+  Set * sets;
+  Line * lines;// Storage of all lines, untouched sets never get paged in
+  const Policy * policy;
+  unsigned long tick;// Number of accesses so far, used as time stamp
+  unsigned long victimAddr;// Address of the block evicted by the last access
+  struct prefetcher_st * pf;// NULL if there is no prefetcher
+  cache_stats_t stats;
+} Cache;
+
+// Per-set xorshift generator, so random choices do not depend on the
+// order in which different sets are accessed
+static unsigned long nextRandom(Set * set) {
+  unsigned long x = set->seed;
+  x ^= x << 13;
+  x ^= x >> 7;
+  x ^= x << 17;
+  set->seed = x;
+  return x;
+}
+
+// Find the line with the smallest time stamp in a set
+static int findOldest(Set * set, int E) {
+  int ind = 0;
+  for (int i = 1; i < E; i++) {
+    if (set->lines[i].stamp < set->lines[ind].stamp) ind = i;
+  }
+  return ind;
+}
+
+/*
+ * LRU: evict the line that was used longest ago
+ */
+static void lruTouch(Cache * cache, Set * set, int way) {
+  set->lines[way].stamp = cache->tick;
+}
+
+static int lruVictim(Cache * cache, Set * set) {
+  return findOldest(set, cache->E);
+}
+
+/*
+ * FIFO: evict the line that was filled longest ago, hits do not matter
+ */
+static void fifoTouch(Cache * cache, Set * set, int way) {
+}
+
+static void fifoFill(Cache * cache, Set * set, int way) {
+  set->lines[way].stamp = cache->tick;
+}
+
+/*
+ * Random: evict any line
+ */
+static void randomTouch(Cache * cache, Set * set, int way) {
+}
+
+static int randomVictim(Cache * cache, Set * set) {
+  return nextRandom(set) % cache->E;
+}
+
+/*
+ * Tree pseudo-LRU: a binary tree over the lines whose internal nodes point
+ * away from the most recently used half. Requires E to be a power of two.
+ */
+static void plruTouch(Cache * cache, Set * set, int way) {
+  unsigned long node = 1;
+  for (int bit = cache->E >> 1; bit > 0; bit >>= 1) {
+    int right = (way & bit) != 0;
+    // Point the node to the other half
+    if (right) set->plru &= ~(1UL << node);
+    else set->plru |= (1UL << node);
+    node = 2 * node + right;
+  }
+}
+
+static int plruVictim(Cache * cache, Set * set) {
+  unsigned long node = 1;
+  int way = 0;
+  for (int bit = cache->E >> 1; bit > 0; bit >>= 1) {
+    int right = (set->plru >> node) & 1;
+    if (right) way |= bit;
+    node = 2 * node + right;
+  }
+  return way;
+}
+
+/*
+ * SRRIP / BRRIP: each line predicts when it will be re-referenced. Hits
+ * predict near-immediate reuse, fills predict a long (SRRIP) or, most of
+ * the time, a distant (BRRIP) re-reference. Lines predicted distant are
+ * evicted first; if there are none, every line in the set is aged.
+ */
+static void rripTouch(Cache * cache, Set * set, int way) {
+  set->lines[way].count = 0;
+}
+
+static void srripFill(Cache * cache, Set * set, int way) {
+  set->lines[way].count = RRPV_MAX - 1;
+}
+
+static void brripFill(Cache * cache, Set * set, int way) {
+  if (nextRandom(set) % BRRIP_LONG_ODDS == 0)
+    set->lines[way].count = RRPV_MAX - 1;
+  else
+    set->lines[way].count = RRPV_MAX;
+}
+
+static int rripVictim(Cache * cache, Set * set) {
+  while (1) {
+    for (int i = 0; i < cache->E; i++) {
+      if (set->lines[i].count >= RRPV_MAX) return i;
+    }
+    for (int i = 0; i < cache->E; i++) {
+      set->lines[i].count++;
+    }
+  }
+}
+
+/*
+ * LFU: evict the line with the fewest uses since it was filled,
+ * the least recently used one among equals
+ */
+static void lfuTouch(Cache * cache, Set * set, int way) {
+  set->lines[way].count++;
+  set->lines[way].stamp = cache->tick;
+}
+
+static void lfuFill(Cache * cache, Set * set, int way) {
+  set->lines[way].count = 1;
+  set->lines[way].stamp = cache->tick;
+}
+
+static int lfuVictim(Cache * cache, Set * set) {
+  int ind = 0;
+  for (int i = 1; i < cache->E; i++) {
+    Line * l = &set->lines[i];
+    Line * m = &set->lines[ind];
+    if (l->count < m->count || (l->count == m->count && l->stamp < m->stamp))
+      ind = i;
+  }
+  return ind;
+}
+
+static const Policy policies[] = {
+  {"lru", lruTouch, lruTouch, lruVictim},
+  {"fifo", fifoTouch, fifoFill, lruVictim},
+  {"random", randomTouch, randomTouch, randomVictim},
+  {"plru", plruTouch, plruTouch, plruVictim},
+  {"srrip", rripTouch, srripFill, rripVictim},
+  {"brrip", rripTouch, brripFill, rripVictim},
+  {"lfu", lfuTouch, lfuFill, lfuVictim},
+};
+#define NUM_POLICIES (sizeof(policies) / sizeof(policies[0]))
+
+const char * cachePolicyName(int i) {
+  return (i >= 0 && i < NUM_POLICIES) ? policies[i].name : NULL;
+}
+
+/*
+ * Prefetchers
+ *
+ * Time is counted in demand accesses: a block prefetched at time t
+ * arrives at t + latency. A demand access to a prefetched block counts
+ * as a useful prefetch (and a hit) if the block has arrived, and as a
+ * late prefetch (and a miss) otherwise. Prefetched blocks that are
+ * evicted or flushed without being demanded are useless.
+ *
+ * next:   on a miss, or on the first use of a prefetched block, prefetch
+ *         the next degree blocks into the cache
+ * stride: a table of streams, one per 4KB page, learns the stride between
+ *         the blocks accessed in the page and, once the same stride was
+ *         seen twice in a row, prefetches degree strides ahead
+ * stream: stream buffers after Jouppi hold prefetched blocks outside the
+ *         cache. A miss that finds its block at the head of a buffer moves
+ *         it into the cache and the buffer prefetches one more block. A
+ *         miss that does not reallocates the least recently used buffer
+ *         to the degree blocks after the missing one.
+ */
+#define PF_NEXT   1
+#define PF_STRIDE 2
+#define PF_STREAM 3
+
+#define STRIDE_ENTRIES 64
+#define STRIDE_PAGE_BITS 12
+#define MAX_STREAM_DEPTH 32
+
+typedef struct stride_st {
+  int valid;
+  unsigned long page;
+  long last;// Last block accessed in the page
+  long stride;// In blocks
+  int confidence;// Number of times in a row the stride repeated
+} StrideEntry;
+
+typedef struct stream_st {
+  int valid;
+  unsigned long lastUse;
+  int head, len;
+  unsigned long next;// Block that the buffer prefetches next
+  unsigned long blocks[MAX_STREAM_DEPTH];
+  unsigned long ready[MAX_STREAM_DEPTH];
+} Stream;
+
+typedef struct prefetcher_st {
+  int kind;
+  int degree;// Blocks prefetched per trigger, or depth of a stream buffer
+  int latency;// Accesses until a prefetched block arrives
+  int nstreams;
+  Stream * streams;
+  StrideEntry strides[STRIDE_ENTRIES];
+} Prefetcher;
+
+cache_t * cacheCreate(int s, int E, int b, const char * policyName) {
+  const Policy * policy = NULL;
+  for (int i = 0; i < NUM_POLICIES; i++) {
+    if (policyName == NULL || strcmp(policies[i].name, policyName) == 0) {
+      policy = &policies[i];
+      break;
+    }
+  }
+  if (policy == NULL || s < 0 || E < 1 || b < 0 || s + b >= 64) return NULL;
+  // The pseudo-LRU tree needs a power of two number of leaves that fit in its bits
+  if (policy->victim == plruVictim && ((E & (E - 1)) != 0 || E > 64)) return NULL;
+
+  int S = (1 << s);
+  Cache * cache = malloc(sizeof(Cache));
+  cache->s = s;
+  cache->E = E;
+  cache->b = b;
+  cache->policy = policy;
+  cache->pf = NULL;
+  cache->sets = malloc(S * sizeof(Set));
+  cache->lines = NULL;
+  cacheReset(cache);
+  return cache;
+}
+
+int cachePrefetch(cache_t * cache, const char * spec) {
+  char kind[16];
+  int degree = 1, latency = 16, nstreams = 4;
+  int n = sscanf(spec, "%15[a-z]:%d:%d:%d", kind, &degree, &latency, &nstreams);
+  if (n < 1 || degree < 1 || latency < 0 || nstreams < 1) return 0;
+
+  Prefetcher * pf = calloc(1, sizeof(Prefetcher));
+  if (strcmp(kind, "next") == 0) pf->kind = PF_NEXT;
+  else if (strcmp(kind, "stride") == 0) pf->kind = PF_STRIDE;
+  else if (strcmp(kind, "stream") == 0 && degree <= MAX_STREAM_DEPTH) pf->kind = PF_STREAM;
+  else {
+    free(pf);
+    return 0;
+  }
+  pf->degree = degree;
+  pf->latency = latency;
+  pf->nstreams = nstreams;
+  pf->streams = calloc(nstreams, sizeof(Stream));
+  if (cache->pf) free(cache->pf->streams);
+  free(cache->pf);
+  cache->pf = pf;
+  return 1;
+}
+
+void cacheReset(cache_t * cache) {
+  int S = (1 << cache->s);
+  int E = cache->E;
+  // Fresh zeroed storage keeps sets that are never touched out of memory
+  free(cache->lines);
+  cache->lines = calloc((size_t)S * E, sizeof(Line));
+  for (int i = 0; i < S; i++) {
+    cache->sets[i].lines = cache->lines + (size_t)i * E;
+    cache->sets[i].plru = 0;
+    cache->sets[i].seed = 2 * i + 1;
+  }
+  if (cache->pf) {
+    memset(cache->pf->strides, 0, sizeof(cache->pf->strides));
+    memset(cache->pf->streams, 0, cache->pf->nstreams * sizeof(Stream));
+  }
+  cache->tick = 0;
+  cache->victimAddr = 0;
+  memset(&cache->stats, 0, sizeof(cache_stats_t));
+}
+
+void cacheFree(cache_t * cache) {
+  if (cache->pf) free(cache->pf->streams);
+  free(cache->pf);
+  free(cache->lines);
+  free(cache->sets);
+  free(cache);
+}
+
+// Find the line holding block in its set, NULL if it is not cached
+static inline Line * findLine(Cache * cache, unsigned long block, Set * * setp) {
+  unsigned long tag = block >> cache->s;
+  Set * set = &cache->sets[block & ((1UL << cache->s) - 1)];
+  *setp = set;
+  for (int i = 0; i < cache->E; i++) {
+    if (set->lines[i].valid && set->lines[i].tag == tag) return &set->lines[i];
+  }
+  return NULL;
+}
+
+// Place block in its set, evicting a line if needed. Returns the line and
+// adds CACHE_EVICT to *result if a valid block was evicted.
+static Line * fillBlock(Cache * cache, Set * set, unsigned long block, int demand, int * result) {
+  // Find if there exists a line in the set with valid bit not set.
+  // If all lines are occupied, ask the policy which line to evict
+  int way = -1;
+  for (int i = 0; i < cache->E; i++) {
+    if (!set->lines[i].valid) {
+      way = i;
+      break;
+    }
+  }
+  if (way == -1) {
+    way = cache->policy->victim(cache, set);
+    Line * victim = &set->lines[way];
+    *result |= CACHE_EVICT;
+    cache->stats.evictions++;
+    if (victim->prefetched) cache->stats.useless++;
+    if (demand) cache->victimAddr = ((victim->tag << cache->s) | (set - cache->sets)) << cache->b;
+  }
+  Line * line = &set->lines[way];
+  line->valid = 1;
+  line->tag = block >> cache->s;
+  line->prefetched = 0;
+  cache->policy->fill(cache, set, way);
+  return line;
+}
+
+// Prefetch block into the cache unless it is there already
+static void prefetchBlock(Cache * cache, unsigned long block) {
+  Set * set;
+  int result = 0;
+  if (findLine(cache, block, &set)) return;
+  Line * line = fillBlock(cache, set, block, 0, &result);
+  line->prefetched = 1;
+  line->ready = cache->tick + cache->pf->latency;
+  cache->stats.prefetches++;
+}
+
+// Train the stride table on a demand access to block and prefetch if confident
+static void strideAccess(Cache * cache, unsigned long block) {
+  Prefetcher * pf = cache->pf;
+  unsigned long page = (block << cache->b) >> STRIDE_PAGE_BITS;
+  StrideEntry * e = &pf->strides[page % STRIDE_ENTRIES];
+  if (!e->valid || e->page != page) {
+    e->valid = 1;
+    e->page = page;
+    e->last = block;
+    e->stride = 0;
+    e->confidence = 0;
+    return;
+  }
+  long delta = (long)block - e->last;
+  if (delta == 0) return;
+  if (delta == e->stride) {
+    if (e->confidence < 3) e->confidence++;
+  } else {
+    e->stride = delta;
+    e->confidence = 0;
+  }
+  e->last = block;
+  if (e->confidence >= 1) {
+    for (int k = 1; k <= pf->degree; k++) prefetchBlock(cache, block + e->stride * k);
+  }
+}
+
+// Append the next block of the stream to the tail of a stream buffer
+static void streamPush(Cache * cache, Stream * st) {
+  int tail = (st->head + st->len) % MAX_STREAM_DEPTH;
+  st->blocks[tail] = st->next++;
+  st->ready[tail] = cache->tick + cache->pf->latency;
+  st->len++;
+  cache->stats.prefetches++;
+}
+
+// Look for block at the head of the stream buffers after a miss. Returns
+// CACHE_HIT if it was there and had arrived, CACHE_MISS if it was there
+// but late, and 0 if no buffer had it, in which case one is reallocated.
+static int streamMiss(Cache * cache, unsigned long block) {
+  Prefetcher * pf = cache->pf;
+  Stream * lru = &pf->streams[0];
+  for (int i = 0; i < pf->nstreams; i++) {
+    Stream * st = &pf->streams[i];
+    if (st->valid && st->len > 0 && st->blocks[st->head] == block) {
+      int result = (cache->tick < st->ready[st->head]) ? CACHE_MISS : CACHE_HIT;
+      st->head = (st->head + 1) % MAX_STREAM_DEPTH;
+      st->len--;
+      st->lastUse = cache->tick;
+      streamPush(cache, st);
+      return result;
+    }
+    if (!st->valid || st->lastUse < lru->lastUse) lru = st;
+  }
+  cache->stats.useless += lru->len;
+  lru->valid = 1;
+  lru->lastUse = cache->tick;
+  lru->head = 0;
+  lru->len = 0;
+  lru->next = block + 1;
+  for (int k = 0; k < pf->degree; k++) streamPush(cache, lru);
+  return 0;
+}
+
+// Simulate one access to the block containing addr, returns CACHE_* flags
+static inline int accessBlock(Cache * cache, unsigned long addr) {
+  unsigned long block = addr >> cache->b;
+  Prefetcher * pf = cache->pf;
+  Set * set;// Reference to the set we are dealing with
+
+  cache->tick++;
+  // Search through all lines in the set to see if we have a hit
+  Line * line = findLine(cache, block, &set);
+  if (line) {
+    int result = CACHE_HIT;
+    int firstUse = line->prefetched;
+    cache->policy->touch(cache, set, line - set->lines);
+    if (firstUse) {
+      line->prefetched = 0;
+      if (cache->tick < line->ready) {
+	result = CACHE_MISS;
+	cache->stats.late++;
+      } else {
+	cache->stats.useful++;
+      }
+    }
+    if (result == CACHE_HIT) cache->stats.hits++;
+    else cache->stats.misses++;
+    if (pf && pf->kind == PF_NEXT && firstUse) {
+      for (int k = 1; k <= pf->degree; k++) prefetchBlock(cache, block + k);
+    }
+    if (pf && pf->kind == PF_STRIDE) strideAccess(cache, block);
+    return result;
+  }
+
+  int result = 0;
+  int fromStream = (pf && pf->kind == PF_STREAM) ? streamMiss(cache, block) : 0;
+  fillBlock(cache, set, block, 1, &result);
+  if (fromStream == CACHE_HIT) {
+    result |= CACHE_HIT;
+    cache->stats.hits++;
+    cache->stats.useful++;
+  } else {
+    result |= CACHE_MISS;
+    cache->stats.misses++;
+    if (fromStream == CACHE_MISS) cache->stats.late++;
+  }
+  if (pf && pf->kind == PF_NEXT) {
+    for (int k = 1; k <= pf->degree; k++) prefetchBlock(cache, block + k);
+  }
+  if (pf && pf->kind == PF_STRIDE) strideAccess(cache, block);
+  return result;
+}
+
+static inline void splitInit(cache_split_t * sp, int b, unsigned long addr, unsigned size) {
+  sp->b = b;
+  sp->next = addr;
+  sp->end = addr + (size > 1 ? size : 1);
+  sp->pieces = 0;
+}
+
+static inline int splitNext(cache_split_t * sp) {
+  if (sp->next >= sp->end) return 0;
+  sp->block = sp->next >> sp->b;
+  sp->start = sp->next;
+  // The piece ends at the end of its block or of the access
+  unsigned long stop = (sp->block + 1) << sp->b;
+  if (stop > sp->end || stop <= sp->start) stop = sp->end;
+  sp->size = stop - sp->start;
+  sp->next = stop;
+  sp->pieces++;
+  return 1;
+}
+
+void cacheSplitInit(cache_split_t * sp, int b, unsigned long addr, unsigned size) {
+  splitInit(sp, b, addr, size);
+}
+
+int cacheSplitNext(cache_split_t * sp) {
+  return splitNext(sp);
+}
+
+// Simulate an access to every block that [addr, addr + size) touches
+static inline int accessRange(Cache * cache, char op, unsigned long addr, unsigned size) {
+  cache_split_t sp;
+  int result = 0;
+  splitInit(&sp, cache->b, addr, size);
+  while (splitNext(&sp)) {
+    result |= accessBlock(cache, sp.start);
+    // For operation 'M', there must be a hit after the first store operation
+    if (op == 'M') cache->stats.hits++;
+  }
+  if (sp.pieces > 1) cache->stats.splits++;
+  return result;
+}
+
+int cacheAccess(cache_t * cache, char op, unsigned long addr, unsigned size) {
+  return accessRange(cache, op, addr, size);
+}
+
+void cacheAccessBatch(cache_t * cache, const cache_ref_t * refs, size_t n) {
+  for (size_t i = 0; i < n; i++) {
+    accessRange(cache, refs[i].op, refs[i].addr, refs[i].size);
+  }
+}
+
+void cacheStats(const cache_t * cache, cache_stats_t * stats) {
+  *stats = cache->stats;
+  // Prefetched blocks that are still waiting for their first use
+  if (cache->pf) {
+    size_t nlines = ((size_t)1 << cache->s) * cache->E;
+    for (size_t i = 0; i < nlines; i++) {
+      if (cache->lines[i].valid && cache->lines[i].prefetched) stats->useless++;
+    }
+    for (int i = 0; i < cache->pf->nstreams; i++) {
+      stats->useless += cache->pf->streams[i].len;
+    }
+  }
+}
+
+unsigned long cacheVictim(const cache_t * cache) {
+  return cache->victimAddr;
+}
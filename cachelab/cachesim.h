@@ -0,0 +1,109 @@
+/*
+ * cachesim.h - A set-associative cache simulator
+ *
+ * csim, test-trans and other tools feed their accesses to it directly
+ * instead of going through trace files.
+ */
+
+#ifndef CACHESIM_H
+#define CACHESIM_H
+
+#include <stddef.h>
+
+/* Result flags of an access */
+#define CACHE_HIT   0x1
+#define CACHE_MISS  0x2
+#define CACHE_EVICT 0x4
+
+typedef struct cache cache_t;
+
+/* A memory access, op is 'L', 'S' or 'M' (a load followed by a store) */
+typedef struct cache_ref {
+    char op;
+    unsigned long addr;
+    unsigned int size;
+} cache_ref_t;
+
+typedef struct cache_stats {
+    unsigned long hits;
+    unsigned long misses;
+    unsigned long evictions;    /* including those caused by prefetches */
+    unsigned long prefetches;   /* prefetches issued */
+    unsigned long useful;       /* prefetched blocks demanded after arrival */
+    unsigned long late;         /* prefetched blocks demanded before arrival */
+    unsigned long useless;      /* prefetched blocks never demanded */
+    unsigned long splits;       /* accesses that straddle a block boundary */
+} cache_stats_t;
+
+/* 
+ * cacheCreate - Create an empty cache of 2^s sets of E lines with blocks
+ *     of 2^b bytes, using the named replacement policy (NULL for LRU).
+ *     Returns NULL if the policy is unknown or does not support E.
+ */
+cache_t *cacheCreate(int s, int E, int b, const char *policy);
+
+/*
+ * cachePrefetch - Attach a prefetcher described by spec, one of
+ *         next[:degree[:latency]]
+ *         stride[:degree[:latency]]
+ *         stream[:depth[:latency[:buffers]]]
+ *     with degree, depth and buffers defaulting to 1, 1 and 4, and the
+ *     latency of a prefetch to 16 accesses. Returns 0 if spec is invalid.
+ */
+int cachePrefetch(cache_t *cache, const char *spec);
+
+/* Free the cache */
+void cacheFree(cache_t *cache);
+
+/*
+ * cacheAccess - Simulate one access of size bytes, returns its CACHE_*
+ *     flags. An access that straddles a block boundary accesses every
+ *     block it touches, and its flags are those of all these blocks.
+ */
+int cacheAccess(cache_t *cache, char op, unsigned long addr, unsigned int size);
+
+/* Simulate n accesses in order, without the overhead of a call per access */
+void cacheAccessBatch(cache_t *cache, const cache_ref_t *refs, size_t n);
+
+/*
+ * Splitting accesses into blocks
+ *
+ * An access that straddles a block boundary touches several blocks. To
+ * visit the part of the access in each of them:
+ *
+ *     cacheSplitInit(&sp, b, addr, size);
+ *     while (cacheSplitNext(&sp))
+ *         ... sp.block, sp.start, sp.size ...
+ *
+ * after which sp.pieces is the number of blocks touched. An access of
+ * size 0 is taken to be one byte, as in cacheAccess.
+ */
+typedef struct cache_split {
+    int b;
+    unsigned long next, end;    /* the part of the access left */
+    unsigned long block;        /* the block of the current piece */
+    unsigned long start;        /* the part of the access in it */
+    unsigned int size;
+    int pieces;                 /* pieces visited so far */
+} cache_split_t;
+
+/* Start splitting the access of size bytes at addr into blocks of 2^b */
+void cacheSplitInit(cache_split_t *sp, int b, unsigned long addr,
+                    unsigned int size);
+
+/* Move to the next piece, returns 0 past the last */
+int cacheSplitNext(cache_split_t *sp);
+
+/* Copy the counts of all accesses since creation or the last reset */
+void cacheStats(const cache_t *cache, cache_stats_t *stats);
+
+/* Empty the cache and clear its counts */
+void cacheReset(cache_t *cache);
+
+/* Address of the block evicted by the last access that evicted one */
+unsigned long cacheVictim(const cache_t *cache);
+
+/* Name of the i-th replacement policy, NULL past the last one */
+const char *cachePolicyName(int i);
+
+#endif /* CACHESIM_H */
@@ -0,0 +1,392 @@
+/*
+ * coherence.c - Private caches of several cores kept coherent by a
+ *               snooping MESI or MOESI protocol, see coherence.h
+ *
+ * Every private cache snoops a shared bus. A load miss issues a BusRd,
+ * which another cache holding the block in M, O or E answers with a
+ * cache-to-cache transfer; a store miss issues a BusRdX and a store to a
+ * shared block a BusUpgr, both of which invalidate all other copies.
+ * Under MESI a modified block that is read by another core is written
+ * back and becomes shared, under MOESI it becomes owned and is written
+ * back only when it is evicted.
+ *
+ * A miss to a block that this core lost through an invalidation is a
+ * coherence miss. It is also a false sharing miss if none of the bytes
+ * the core now accesses were written by another core since it lost the
+ * block. Written bytes are tracked in up to 64 granules per block.
+ *
+ * Author: Jieyu Lu
+ * Andrew ID: jieyul1
+ */
+#include <stdlib.h>
+#include <string.h>
+#include "coherence.h"
+
+// Line states
+#define INVALID   0
+#define SHARED    1
+#define EXCLUSIVE 2
+#define OWNED     3
+#define MODIFIED  4
+
+typedef struct cline_st {
+  int state;
+  unsigned long tag;
+  unsigned long stamp;// Time of last use, for LRU
+} CLine;
+
+// Open addressing hash index from block number to a position in an array
+typedef struct index_st {
+  unsigned long * keys;// Block number + 1, 0 marks an empty slot
+  int * values;
+  size_t cap;
+  size_t len;
+} Index;
+
+// A block this core lost through an invalidation
+typedef struct lost_st {
+  int active;// Still lost, the core has not missed on it since
+  unsigned long written;// Granules written by other cores since then
+} Lost;
+
+// Per-line counters of the report
+typedef struct blockinfo_st {
+  unsigned long block;
+  long invalidations;
+  long coherenceMisses;
+  long falseSharing;
+} BlockInfo;
+
+typedef struct core_st {
+  CLine * lines;// lines[set * E + way]
+  Index lostIndex;
+  Lost * lost;
+  size_t nlost;
+  long hits, misses, evictions;
+  long coherenceMisses;
+  long falseSharing;
+  long invalidations;// Copies of this core invalidated by others
+  long upgrades;
+} Core;
+
+struct coherence {
+  int ncores;
+  int s, E, b;
+  int moesi;
+  cache_t * llc;
+  Core * cores;
+  unsigned long tick;
+  Index blockIndex;
+  BlockInfo * blocks;
+  size_t nblocks;
+  // Bus transactions
+  long busReads, busReadXs, busUpgrades;
+  long transfers;// Blocks supplied by another private cache
+  long writebacks;
+  long memReads;// Blocks read from the LLC or memory
+};
+
+static size_t hashKey(unsigned long key, size_t cap) {
+  return (key * 0x9E3779B97F4A7C15UL) >> 17 & (cap - 1);
+}
+
+static size_t indexSlot(Index * ix, unsigned long key) {
+  size_t i = hashKey(key, ix->cap);
+  while (ix->keys[i] != 0 && ix->keys[i] != key) i = (i + 1) & (ix->cap - 1);
+  return i;
+}
+
+static void indexGrow(Index * ix) {
+  Index old = *ix;
+  ix->cap = old.cap ? 2 * old.cap : 256;
+  ix->keys = calloc(ix->cap, sizeof(unsigned long));
+  ix->values = malloc(ix->cap * sizeof(int));
+  for (size_t i = 0; i < old.cap; i++) {
+    if (old.keys[i] == 0) continue;
+    size_t j = indexSlot(ix, old.keys[i]);
+    ix->keys[j] = old.keys[i];
+    ix->values[j] = old.values[i];
+  }
+  free(old.keys);
+  free(old.values);
+}
+
+// Position of block in the indexed array, -1 if it has none
+static int indexFind(Index * ix, unsigned long block) {
+  if (ix->cap == 0) return -1;
+  size_t i = indexSlot(ix, block + 1);
+  return ix->keys[i] ? ix->values[i] : -1;
+}
+
+static void indexPut(Index * ix, unsigned long block, int value) {
+  if (2 * (ix->len + 1) > ix->cap) indexGrow(ix);
+  size_t i = indexSlot(ix, block + 1);
+  if (ix->keys[i] == 0) ix->len++;
+  ix->keys[i] = block + 1;
+  ix->values[i] = value;
+}
+
+// The counters of block, created on first use
+static BlockInfo * blockInfo(coherence_t * coh, unsigned long block) {
+  int i = indexFind(&coh->blockIndex, block);
+  if (i < 0) {
+    if ((coh->nblocks & (coh->nblocks - 1)) == 0)
+      coh->blocks = realloc(coh->blocks, (coh->nblocks ? 2 * coh->nblocks : 1) * sizeof(BlockInfo));
+    i = coh->nblocks++;
+    memset(&coh->blocks[i], 0, sizeof(BlockInfo));
+    coh->blocks[i].block = block;
+    indexPut(&coh->blockIndex, block, i);
+  }
+  return &coh->blocks[i];
+}
+
+// The lost record of block in core, created inactive on first use
+static Lost * lostEntry(Core * core, unsigned long block, int create) {
+  int i = indexFind(&core->lostIndex, block);
+  if (i < 0) {
+    if (!create) return NULL;
+    if ((core->nlost & (core->nlost - 1)) == 0)
+      core->lost = realloc(core->lost, (core->nlost ? 2 * core->nlost : 1) * sizeof(Lost));
+    i = core->nlost++;
+    core->lost[i].active = 0;
+    core->lost[i].written = 0;
+    indexPut(&core->lostIndex, block, i);
+  }
+  return &core->lost[i];
+}
+
+static CLine * findLine(coherence_t * coh, Core * core, unsigned long block) {
+  CLine * set = &core->lines[(block & ((1UL << coh->s) - 1)) * coh->E];
+  unsigned long tag = block >> coh->s;
+  for (int i = 0; i < coh->E; i++) {
+    if (set[i].state != INVALID && set[i].tag == tag) return &set[i];
+  }
+  return NULL;
+}
+
+// Granules of the block touched by an access of size bytes at addr, which
+// lies within one block
+static unsigned long granules(coherence_t * coh, unsigned long addr, unsigned size) {
+  unsigned long B = 1UL << coh->b;
+  unsigned long granule = B > 64 ? B / 64 : 1;
+  unsigned long first = (addr & (B - 1));
+  unsigned long last = first + (size ? size : 1) - 1;
+  first /= granule;
+  last /= granule;
+  unsigned long upper = (last == 63) ? ~0UL : ((1UL << (last + 1)) - 1);
+  return upper & ~((1UL << first) - 1);
+}
+
+// Invalidate the copies of block in all cores but requester, returns 1 if
+// one of them was dirty and supplied the block
+static int invalidateOthers(coherence_t * coh, int requester, unsigned long block) {
+  int supplied = 0;
+  for (int d = 0; d < coh->ncores; d++) {
+    if (d == requester) continue;
+    CLine * line = findLine(coh, &coh->cores[d], block);
+    if (line == NULL) continue;
+    if (line->state == MODIFIED || line->state == OWNED) supplied = 1;
+    line->state = INVALID;
+    coh->cores[d].invalidations++;
+    blockInfo(coh, block)->invalidations++;
+    Lost * lost = lostEntry(&coh->cores[d], block, 1);
+    lost->active = 1;
+    lost->written = 0;
+  }
+  return supplied;
+}
+
+// Place block in core's cache, writing back the victim if it is dirty
+static CLine * fillLine(coherence_t * coh, Core * core, unsigned long block) {
+  unsigned setInd = block & ((1UL << coh->s) - 1);
+  CLine * set = &core->lines[setInd * coh->E];
+  CLine * victim = &set[0];
+  for (int i = 0; i < coh->E; i++) {
+    if (set[i].state == INVALID) {
+      victim = &set[i];
+      break;
+    }
+    if (set[i].stamp < victim->stamp) victim = &set[i];
+  }
+  if (victim->state != INVALID) {
+    core->evictions++;
+    if (victim->state == MODIFIED || victim->state == OWNED) {
+      coh->writebacks++;
+      if (coh->llc)
+	cacheAccess(coh->llc, 'S', ((victim->tag << coh->s) | setInd) << coh->b, 1);
+    }
+  }
+  victim->tag = block >> coh->s;
+  return victim;
+}
+
+static void accessOne(coherence_t * coh, int c, int write, unsigned long addr, unsigned size) {
+  Core * core = &coh->cores[c];
+  unsigned long block = addr >> coh->b;
+  unsigned long touched = granules(coh, addr, size);
+  CLine * line = findLine(coh, core, block);
+
+  coh->tick++;
+  if (line) {
+    core->hits++;
+    if (write && (line->state == SHARED || line->state == OWNED)) {
+      coh->busUpgrades++;
+      core->upgrades++;
+      invalidateOthers(coh, c, block);
+    }
+    if (write) line->state = MODIFIED;
+  } else {
+    core->misses++;
+    Lost * lost = lostEntry(core, block, 0);
+    if (lost && lost->active) {
+      BlockInfo * info = blockInfo(coh, block);
+      core->coherenceMisses++;
+      info->coherenceMisses++;
+      if ((lost->written & touched) == 0) {
+	core->falseSharing++;
+	info->falseSharing++;
+      }
+      lost->active = 0;
+    }
+
+    int supplied = 0;
+    int state;
+    if (write) {
+      coh->busReadXs++;
+      supplied = invalidateOthers(coh, c, block);
+      state = MODIFIED;
+    } else {
+      int shared = 0;
+      coh->busReads++;
+      for (int d = 0; d < coh->ncores; d++) {
+	CLine * other = (d == c) ? NULL : findLine(coh, &coh->cores[d], block);
+	if (other == NULL) continue;
+	shared = 1;
+	if (other->state == MODIFIED) {
+	  supplied = 1;
+	  if (coh->moesi) {
+	    other->state = OWNED;
+	  } else {
+	    other->state = SHARED;
+	    coh->writebacks++;
+	    if (coh->llc) cacheAccess(coh->llc, 'S', addr, 1);
+	  }
+	} else if (other->state == OWNED || other->state == EXCLUSIVE) {
+	  supplied = 1;
+	  if (other->state == EXCLUSIVE) other->state = SHARED;
+	}
+      }
+      state = shared ? SHARED : EXCLUSIVE;
+    }
+    if (supplied) {
+      coh->transfers++;
+    } else {
+      coh->memReads++;
+      if (coh->llc) cacheAccess(coh->llc, 'L', addr, 1);
+    }
+    line = fillLine(coh, core, block);
+    line->state = state;
+  }
+  line->stamp = coh->tick;
+
+  // Remember what other cores would find changed when they come back
+  if (write) {
+    for (int d = 0; d < coh->ncores; d++) {
+      if (d == c) continue;
+      Lost * lost = lostEntry(&coh->cores[d], block, 0);
+      if (lost && lost->active) lost->written |= touched;
+    }
+  }
+}
+
+coherence_t * coherenceCreate(int ncores, int s, int E, int b, int moesi, cache_t * llc) {
+  coherence_t * coh = calloc(1, sizeof(coherence_t));
+  coh->ncores = ncores;
+  coh->s = s;
+  coh->E = E;
+  coh->b = b;
+  coh->moesi = moesi;
+  coh->llc = llc;
+  coh->cores = calloc(ncores, sizeof(Core));
+  for (int c = 0; c < ncores; c++) {
+    coh->cores[c].lines = calloc(((size_t)1 << s) * E, sizeof(CLine));
+  }
+  return coh;
+}
+
+void coherenceFree(coherence_t * coh) {
+  for (int c = 0; c < coh->ncores; c++) {
+    free(coh->cores[c].lines);
+    free(coh->cores[c].lost);
+    free(coh->cores[c].lostIndex.keys);
+    free(coh->cores[c].lostIndex.values);
+  }
+  free(coh->cores);
+  free(coh->blocks);
+  free(coh->blockIndex.keys);
+  free(coh->blockIndex.values);
+  free(coh);
+}
+
+void coherenceAccess(coherence_t * coh, int core, char op, unsigned long addr, unsigned size) {
+  cache_split_t sp;
+  // An access that straddles blocks touches each of them, and 'M' is a
+  // load followed by a store to the same bytes
+  cacheSplitInit(&sp, coh->b, addr, size);
+  while (cacheSplitNext(&sp)) {
+    if (op == 'L' || op == 'M') accessOne(coh, core, 0, sp.start, sp.size);
+    if (op == 'S' || op == 'M') accessOne(coh, core, 1, sp.start, sp.size);
+  }
+}
+
+void coherenceTotals(const coherence_t * coh, cache_stats_t * stats) {
+  memset(stats, 0, sizeof(cache_stats_t));
+  for (int c = 0; c < coh->ncores; c++) {
+    stats->hits += coh->cores[c].hits;
+    stats->misses += coh->cores[c].misses;
+    stats->evictions += coh->cores[c].evictions;
+  }
+}
+
+// Order lines by coherence misses, then invalidations, most first
+static int compareBlocks(const void * x, const void * y) {
+  const BlockInfo * p = x;
+  const BlockInfo * q = y;
+  if (p->coherenceMisses != q->coherenceMisses) return p->coherenceMisses < q->coherenceMisses ? 1 : -1;
+  if (p->invalidations != q->invalidations) return p->invalidations < q->invalidations ? 1 : -1;
+  return (p->block > q->block) - (p->block < q->block);
+}
+
+void coherenceReport(const coherence_t * coh, FILE * out, int top) {
+  fprintf(out, "\n%s coherence, %d cores\n", coh->moesi ? "MOESI" : "MESI", coh->ncores);
+  fprintf(out, "%6s %10s %10s %10s %10s %10s %10s %10s\n", "core", "hits", "misses",
+	  "evictions", "coherence", "false", "invalidated", "upgrades");
+  for (int c = 0; c < coh->ncores; c++) {
+    Core * core = &coh->cores[c];
+    fprintf(out, "%6d %10ld %10ld %10ld %10ld %10ld %10ld %10ld\n", c, core->hits, core->misses,
+	    core->evictions, core->coherenceMisses, core->falseSharing, core->invalidations,
+	    core->upgrades);
+  }
+  fprintf(out, "bus: reads:%ld readxs:%ld upgrades:%ld transfers:%ld writebacks:%ld memreads:%ld\n",
+	  coh->busReads, coh->busReadXs, coh->busUpgrades, coh->transfers, coh->writebacks,
+	  coh->memReads);
+  if (coh->llc) {
+    cache_stats_t llc;
+    cacheStats(coh->llc, &llc);
+    fprintf(out, "llc: hits:%lu misses:%lu evictions:%lu\n", llc.hits, llc.misses, llc.evictions);
+  }
+
+  BlockInfo * sorted = malloc((coh->nblocks + 1) * sizeof(BlockInfo));
+  size_t n = 0;
+  for (size_t i = 0; i < coh->nblocks; i++) {
+    if (coh->blocks[i].invalidations > 0) sorted[n++] = coh->blocks[i];
+  }
+  qsort(sorted, n, sizeof(BlockInfo), compareBlocks);
+  fprintf(out, "\nLines with the most coherence misses:\n");
+  fprintf(out, "%18s %13s %10s %14s\n", "line", "invalidations", "coherence", "false sharing");
+  for (size_t i = 0; i < n && i < (size_t)top; i++) {
+    fprintf(out, "%18lx %13ld %10ld %14ld\n", sorted[i].block << coh->b,
+	    sorted[i].invalidations, sorted[i].coherenceMisses, sorted[i].falseSharing);
+  }
+  free(sorted);
+}
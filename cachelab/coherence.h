@@ -0,0 +1,39 @@
+/*
+ * coherence.h - Private caches of several cores kept coherent by a
+ *     snooping MESI or MOESI protocol, over an optional shared LLC
+ */
+
+#ifndef COHERENCE_H
+#define COHERENCE_H
+
+#include <stdio.h>
+#include "cachesim.h"
+
+typedef struct coherence coherence_t;
+
+/*
+ * coherenceCreate - Create ncores private LRU caches of 2^s sets of E
+ *     lines with blocks of 2^b bytes. Blocks that no private cache can
+ *     supply are looked up in llc, or come from memory if llc is NULL.
+ *     moesi selects MOESI instead of MESI.
+ */
+coherence_t *coherenceCreate(int ncores, int s, int E, int b, int moesi,
+                             cache_t *llc);
+
+/* Free the caches, but not the LLC */
+void coherenceFree(coherence_t *coh);
+
+/* Simulate an access of size bytes by core, op is 'L', 'S' or 'M' */
+void coherenceAccess(coherence_t *coh, int core, char op, unsigned long addr,
+                     unsigned int size);
+
+/* Sum of the hits, misses and evictions of all private caches */
+void coherenceTotals(const coherence_t *coh, cache_stats_t *stats);
+
+/*
+ * coherenceReport - Print the counts of each core and of the bus, and the
+ *     top lines by coherence misses with their false sharing
+ */
+void coherenceReport(const coherence_t *coh, FILE *out, int top);
+
+#endif /* COHERENCE_H */
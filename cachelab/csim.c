@@ -1,40 +1,881 @@
 /*
  * 15213 cache lab Part A -- Cache Simulator
- * 
+ *
  * Author: Jieyu Lu
  * Andrew ID: jieyul1
  */
+#define _POSIX_C_SOURCE 200809L
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <limits.h>
 #include <unistd.h>
 #include <getopt.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include "cachelab.h"
+#include "cachesim.h"
+#include "coherence.h"
+#include "tlb.h"
+#include "timing.h"
 
-// Structor that simulates the behavior of a cache line
-typedef struct line_st {
-  int valid;
-  int timeStamp;
-  unsigned long tag;
-} Line;
-typedef Line * Set;
-typedef Set * Cache;
+/*
+ * Parallel simulation
+ *
+ * Sets never interact, so the trace can be split by set index. The trace
+ * is mapped into memory and streamed in rounds of up to ROUND_BYTES per
+ * thread, each cut into one chunk per thread. In the first phase of a
+ * round each thread parses its chunk and hands every record to the queue
+ * of the thread that owns its set. After all threads are done parsing,
+ * each thread simulates its own sets, reading the queues addressed to it
+ * chunk by chunk so that the accesses to a set keep their trace order.
+ * The queues are emptied for the next round, so they never hold more
+ * than one round of the trace.
+ */
+#define ROUND_BYTES (1 << 20)
+
+// Growable array of records
+typedef struct queue_st {
+  cache_ref_t * recs;
+  size_t len;
+  size_t cap;
+} Queue;
+
+typedef struct worker_st {
+  int id;
+  int nthreads;
+  const char * trace;// The whole trace
+  const char * end;
+  Queue * queues;// queues[c * nthreads + t] holds records of chunk c for thread t
+  pthread_barrier_t * barrier;
+  int s, E, b;
+  const char * policy;
+  unsigned long splits;// Records of the chunk that straddle a block boundary
+  cache_stats_t stats;
+} Worker;
+
+void pushRecord(Queue * q, unsigned long addr, unsigned size, char op) {
+  if (q->len == q->cap) {
+    q->cap = q->cap ? 2 * q->cap : 1024;
+    q->recs = realloc(q->recs, q->cap * sizeof(cache_ref_t));
+  }
+  q->recs[q->len].addr = addr;
+  q->recs[q->len].op = op;
+  q->recs[q->len].size = size;
+  q->len++;
+}
+
+// Parse the next " op addr,size" line starting at *pos, returns 0 at the end
+int parseRecord(const char * * pos, const char * end, char * op, unsigned long * addr,
+		unsigned * size) {
+  const char * p = *pos;
+  while (1) {
+    while (p < end && (*p == ' ' || *p == '\t' || *p == '\n' || *p == '\r')) p++;
+    if (p >= end) return 0;
+    *op = *p++;
+    while (p < end && *p == ' ') p++;
+    unsigned long a = 0;
+    int digits = 0;
+    for (; p < end; p++, digits++) {
+      char c = *p;
+      if (c >= '0' && c <= '9') a = (a << 4) | (c - '0');
+      else if (c >= 'a' && c <= 'f') a = (a << 4) | (c - 'a' + 10);
+      else if (c >= 'A' && c <= 'F') a = (a << 4) | (c - 'A' + 10);
+      else break;
+    }
+    unsigned sz = 0;
+    if (p < end && *p == ',') {
+      for (p++; p < end && *p >= '0' && *p <= '9'; p++) sz = sz * 10 + (*p - '0');
+    }
+    // Skip anything else up to the end of the line
+    while (p < end && *p != '\n') p++;
+    if (digits > 0 && (*op == 'L' || *op == 'S' || *op == 'M')) {
+      *addr = a;
+      *size = sz;
+      *pos = p;
+      return 1;
+    }
+  }
+}
+
+// Start of the first line at or after p, or end
+const char * lineStart(const char * trace, const char * end, const char * p) {
+  while (p > trace && p < end && p[-1] != '\n') p++;
+  return p < end ? p : end;
+}
+
+void * runWorker(void * arg) {
+  Worker * w = arg;
+  int n = w->nthreads;
+  int S = (1 << w->s);
+  const char * round = w->trace;
+  char op;
+  unsigned long addr;
+  unsigned size;
+  cache_split_t sp;
+  cache_t * cache = cacheCreate(w->s, w->E, w->b, w->policy);
+
+  // Every thread cuts the rounds and chunks the same way
+  while (round < w->end) {
+    size_t len = w->end - round;
+    if (len > (size_t)ROUND_BYTES * n) len = (size_t)ROUND_BYTES * n;
+    const char * roundEnd = lineStart(w->trace, w->end, round + len);
+    size_t chunk = (roundEnd - round) / n;
+    const char * pos = lineStart(w->trace, roundEnd, round + chunk * w->id);
+    const char * stop = (w->id == n - 1) ? roundEnd :
+      lineStart(w->trace, roundEnd, round + chunk * (w->id + 1));
+
+    // Phase 1: parse the chunk and distribute the records by owner of the
+    // set, splitting those that straddle blocks into one record per block
+    for (int t = 0; t < n; t++) w->queues[w->id * n + t].len = 0;
+    while (parseRecord(&pos, stop, &op, &addr, &size)) {
+      cacheSplitInit(&sp, w->b, addr, size);
+      while (cacheSplitNext(&sp)) {
+	unsigned setInd = sp.block & (S - 1);
+	pushRecord(&w->queues[w->id * n + setInd % n], sp.start, sp.size, op);
+      }
+      if (sp.pieces > 1) w->splits++;
+    }
+    pthread_barrier_wait(w->barrier);
+
+    // Phase 2: simulate the sets owned by this thread in trace order
+    for (int c = 0; c < n; c++) {
+      Queue * q = &w->queues[c * n + w->id];
+      cacheAccessBatch(cache, q->recs, q->len);
+    }
+    // The queues are refilled only once every thread has read them
+    pthread_barrier_wait(w->barrier);
+    round = roundEnd;
+  }
+  cacheStats(cache, &w->stats);
+  cacheFree(cache);
+  return NULL;
+}
+
+// Simulate the trace in fileStr with nthreads threads, returns 0 on failure
+int simulateParallel(const char * fileStr, int nthreads, int s, int E, int b,
+		     const char * policy, cache_stats_t * total) {
+  int fd = open(fileStr, O_RDONLY);
+  if (fd < 0) {
+    printf("Unable to open file \"%s\"\n", fileStr);
+    return 0;
+  }
+  struct stat st;
+  if (fstat(fd, &st) < 0) {
+    close(fd);
+    return 0;
+  }
+  size_t size = st.st_size;
+  const char * trace = "";
+  if (size > 0) {
+    trace = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (trace == MAP_FAILED) {
+      printf("Unable to map file \"%s\"\n", fileStr);
+      close(fd);
+      return 0;
+    }
+  }
+  close(fd);
+
+  Worker * workers = calloc(nthreads, sizeof(Worker));
+  Queue * queues = calloc((size_t)nthreads * nthreads, sizeof(Queue));
+  pthread_t * tids = malloc(nthreads * sizeof(pthread_t));
+  pthread_barrier_t barrier;
+  pthread_barrier_init(&barrier, NULL, nthreads);
+
+  for (int i = 0; i < nthreads; i++) {
+    workers[i].id = i;
+    workers[i].nthreads = nthreads;
+    workers[i].trace = trace;
+    workers[i].end = trace + size;
+    workers[i].queues = queues;
+    workers[i].barrier = &barrier;
+    workers[i].s = s;
+    workers[i].E = E;
+    workers[i].b = b;
+    workers[i].policy = policy;
+  }
+  for (int i = 0; i < nthreads; i++) {
+    pthread_create(&tids[i], NULL, runWorker, &workers[i]);
+  }
+  for (int i = 0; i < nthreads; i++) {
+    pthread_join(tids[i], NULL);
+    total->hits += workers[i].stats.hits;
+    total->misses += workers[i].stats.misses;
+    total->evictions += workers[i].stats.evictions;
+    total->splits += workers[i].splits;
+  }
+
+  pthread_barrier_destroy(&barrier);
+  for (int i = 0; i < nthreads * nthreads; i++) {
+    free(queues[i].recs);
+  }
+  free(queues);
+  free(workers);
+  free(tids);
+  if (size > 0) munmap((void *)trace, size);
+  return 1;
+}
+
+/*
+ * Miss analysis
+ *
+ * Every miss is classified by the 3C model: compulsory if the block has
+ * never been accessed before, capacity if a fully-associative LRU cache
+ * with the same number of lines would miss as well, and conflict
+ * otherwise. A fully-associative LRU cache of C lines hits exactly when
+ * fewer than C distinct blocks were accessed since the previous access
+ * to the block (the reuse distance), so the shadow cache is represented
+ * by the reuse distances themselves.
+ *
+ * Reuse distances are counted with a Fenwick tree over access times,
+ * where the time of the most recent access to each block is marked.
+ * The distance of an access is the number of marks after the previous
+ * access to the same block. Only the order of the marks matters, so when
+ * the tree fills up they are renumbered 1..n, which keeps its size within
+ * a small factor of the number of distinct blocks.
+ */
+#define HIST_BUCKETS 40
+
+// Open addressing hash map from block number to time of its last access
+typedef struct blockmap_st {
+  unsigned long * keys;// Block number + 1, 0 marks an empty slot
+  unsigned long * times;
+  size_t cap;
+  size_t len;
+} BlockMap;
+
+typedef struct analysis_st {
+  BlockMap last;
+  int * tree;// Fenwick tree over access times 1..treeCap-1
+  char * marked;// If a time is the last access of some block
+  size_t treeCap;
+  unsigned long tick;// Time of the current access, renumbered with the marks
+  unsigned long lines;// Number of lines of the shadow cache
+  long compulsory, capacity, conflict;
+  long cold;// First accesses, whose reuse distance is infinite
+  long hist[HIST_BUCKETS];// Bucket 0 is distance 0, bucket k is [2^(k-1), 2^k)
+} Analysis;
+
+size_t hashBlock(unsigned long key, size_t cap) {
+  return (key * 0x9E3779B97F4A7C15UL) >> 17 & (cap - 1);
+}
+
+// Return the slot of key, or of the empty slot where it would go
+size_t findBlock(BlockMap * map, unsigned long key) {
+  size_t i = hashBlock(key, map->cap);
+  while (map->keys[i] != 0 && map->keys[i] != key) i = (i + 1) & (map->cap - 1);
+  return i;
+}
+
+void growBlockMap(BlockMap * map) {
+  BlockMap old = *map;
+  map->cap = old.cap ? 2 * old.cap : 1024;
+  map->keys = calloc(map->cap, sizeof(unsigned long));
+  map->times = malloc(map->cap * sizeof(unsigned long));
+  for (size_t i = 0; i < old.cap; i++) {
+    if (old.keys[i] == 0) continue;
+    size_t j = findBlock(map, old.keys[i]);
+    map->keys[j] = old.keys[i];
+    map->times[j] = old.times[i];
+  }
+  free(old.keys);
+  free(old.times);
+}
+
+void treeAdd(Analysis * an, size_t t, int delta) {
+  an->marked[t] += delta;
+  for (; t < an->treeCap; t += t & -t) an->tree[t] += delta;
+}
+
+// Number of marks at times 1..t
+long treeSum(Analysis * an, size_t t) {
+  long sum = 0;
+  for (; t > 0; t -= t & -t) sum += an->tree[t];
+  return sum;
+}
 
-// Find the least recently used line in a set according to the time stamp associated with each line
-int findLRU(Set s, int E) {
-  int ind = 0;
-  int maxStamp = 0;
-  for (int i = 0; i < E; i++) {
-    if (s[i].timeStamp > maxStamp) {
-      ind = i;
-      maxStamp = s[i].timeStamp;
+// Double the range of times covered by the tree
+void growTree(Analysis * an) {
+  size_t oldCap = an->treeCap;
+  char * oldMarked = an->marked;
+  an->treeCap = oldCap ? 2 * oldCap : 1024;
+  free(an->tree);
+  an->tree = calloc(an->treeCap, sizeof(int));
+  an->marked = calloc(an->treeCap, 1);
+  for (size_t t = 1; t < oldCap; t++) {
+    if (oldMarked[t]) treeAdd(an, t, 1);
+  }
+  free(oldMarked);
+}
+
+// Renumber the marked times 1..n in order, with the times in the block map
+void compactTree(Analysis * an) {
+  for (size_t i = 0; i < an->last.cap; i++) {
+    if (an->last.keys[i]) an->last.times[i] = treeSum(an, an->last.times[i]);
+  }
+  memset(an->tree, 0, an->treeCap * sizeof(int));
+  memset(an->marked, 0, an->treeCap);
+  for (size_t t = 1; t <= an->last.len; t++) treeAdd(an, t, 1);
+  an->tick = an->last.len + 1;
+}
+
+void initAnalysis(Analysis * an, unsigned long lines) {
+  memset(an, 0, sizeof(Analysis));
+  an->lines = lines;
+  growBlockMap(&an->last);
+  growTree(an);
+}
+
+void freeAnalysis(Analysis * an) {
+  free(an->last.keys);
+  free(an->last.times);
+  free(an->tree);
+  free(an->marked);
+}
+
+// Record one access to block, whose result in the simulated cache was result
+void analyzeAccess(Analysis * an, unsigned long block, int result) {
+  an->tick++;
+  if (an->tick >= an->treeCap) {
+    // Grow only if renumbering would leave less than half of the tree free
+    if (2 * an->last.len < an->treeCap) compactTree(an);
+    else growTree(an);
+  }
+  if (2 * (an->last.len + 1) > an->last.cap) growBlockMap(&an->last);
+
+  size_t slot = findBlock(&an->last, block + 1);
+  if (an->last.keys[slot] == 0) {
+    an->last.keys[slot] = block + 1;
+    an->last.len++;
+    an->cold++;
+    if (result & CACHE_MISS) an->compulsory++;
+  } else {
+    unsigned long prev = an->last.times[slot];
+    long dist = treeSum(an, an->tick - 1) - treeSum(an, prev);
+    int bucket = 0;
+    while (bucket < HIST_BUCKETS - 1 && (1L << bucket) <= dist) bucket++;
+    an->hist[bucket]++;
+    if (result & CACHE_MISS) {
+      if (dist >= an->lines) an->capacity++;
+      else an->conflict++;
+    }
+    treeAdd(an, prev, -1);
+  }
+  an->last.times[slot] = an->tick;
+  treeAdd(an, an->tick, 1);
+}
+
+void printAnalysis(Analysis * an) {
+  printf("\nMiss classification: compulsory:%ld capacity:%ld conflict:%ld\n",
+	 an->compulsory, an->capacity, an->conflict);
+  printf("(capacity misses would also miss in a fully-associative LRU cache of %lu lines)\n",
+	 an->lines);
+  printf("\nReuse distance histogram (distinct blocks accessed between uses):\n");
+  printf("%16s %10ld\n", "cold", an->cold);
+  int top = HIST_BUCKETS - 1;
+  while (top > 0 && an->hist[top] == 0) top--;
+  for (int k = 0; k <= top; k++) {
+    char range[64];
+    // Bucket k holds the distances lo..hi, the last one has no end
+    unsigned long lo = k == 0 ? 0 : 1UL << (k - 1);
+    unsigned long hi = k == 0 ? 0 : k == HIST_BUCKETS - 1 ? ULONG_MAX : (1UL << k) - 1;
+    if (k <= 1) sprintf(range, "%lu", lo);
+    else if (k == HIST_BUCKETS - 1) sprintf(range, "%lu+", lo);
+    else sprintf(range, "%lu-%lu", lo, hi);
+    printf("%16s %10ld%s\n", range, an->hist[k],
+	   (lo <= an->lines && an->lines <= hi) ? "  <- cache size" : "");
+  }
+}
+
+/*
+ * Region attribution
+ *
+ * A region map names address ranges holding row-major matrices, one per
+ * line as "name base rows cols elemsize" (base in hex, '#' starts a
+ * comment); tracegen writes one for A and B to .regions. Hits and misses
+ * are attributed to the region holding the accessed address, misses also
+ * to square tiles of the matrix one cache block wide. Every eviction is
+ * recorded as a pair of the region that lost the block and the region
+ * whose access evicted it, and misses are counted per set, which shows
+ * the sets in which the matrices fight each other.
+ */
+#define MAX_REGIONS 16
+
+typedef struct region_st {
+  char name[32];
+  unsigned long base;
+  int rows, cols, elemSize;
+  int tile;// Side of a tile in elements
+  int gridRows, gridCols;// Number of tiles along each dimension
+  long hits, misses;
+  long * tileMisses;
+  long evictedBy[MAX_REGIONS + 1];// Evictions of this region's blocks, by region of the access
+} Region;
+
+typedef struct regionmap_st {
+  int n;// regions[n] is everything outside the named regions
+  Region regions[MAX_REGIONS + 1];
+  int S;
+  int b;
+  long * setMisses;// setMisses[set * (n + 1) + region]
+  long * setEvictions;
+} RegionMap;
+
+// Find the region holding addr, n if it is in none of them
+int findRegion(RegionMap * map, unsigned long addr) {
+  for (int i = 0; i < map->n; i++) {
+    Region * r = &map->regions[i];
+    if (addr >= r->base && addr < r->base + (unsigned long)r->rows * r->cols * r->elemSize)
+      return i;
+  }
+  return map->n;
+}
+
+// Read the region map in fileStr, returns 0 on failure
+int loadRegions(RegionMap * map, const char * fileStr, int s, int b) {
+  FILE * fptr = fopen(fileStr, "r");
+  if (fptr == NULL) {
+    printf("Unable to open file \"%s\"\n", fileStr);
+    return 0;
+  }
+  memset(map, 0, sizeof(RegionMap));
+  char buf[256];
+  while (fgets(buf, sizeof(buf), fptr) != NULL) {
+    Region * r = &map->regions[map->n];
+    char * comment = strchr(buf, '#');
+    if (comment) *comment = '\0';
+    if (sscanf(buf, "%31s", r->name) != 1) continue;
+    if (map->n == MAX_REGIONS ||
+	sscanf(buf, "%*s %lx %d %d %d", &r->base, &r->rows, &r->cols, &r->elemSize) != 4 ||
+	r->rows <= 0 || r->cols <= 0 || r->elemSize <= 0) {
+      printf("Bad region \"%s\" in \"%s\"\n", r->name, fileStr);
+      fclose(fptr);
+      return 0;
+    }
+    r->tile = (1 << b) / r->elemSize;
+    if (r->tile < 1) r->tile = 1;
+    r->gridRows = (r->rows + r->tile - 1) / r->tile;
+    r->gridCols = (r->cols + r->tile - 1) / r->tile;
+    r->tileMisses = calloc((size_t)r->gridRows * r->gridCols, sizeof(long));
+    map->n++;
+  }
+  fclose(fptr);
+  strcpy(map->regions[map->n].name, "other");
+  map->S = 1 << s;
+  map->b = b;
+  map->setMisses = calloc((size_t)map->S * (map->n + 1), sizeof(long));
+  map->setEvictions = calloc(map->S, sizeof(long));
+  return 1;
+}
+
+void freeRegions(RegionMap * map) {
+  for (int i = 0; i < map->n; i++) {
+    free(map->regions[i].tileMisses);
+  }
+  free(map->setMisses);
+  free(map->setEvictions);
+}
+
+// Attribute the result of an access of operation op to addr
+void attributeAccess(RegionMap * map, cache_t * cache, char op, unsigned long addr, int result) {
+  int k = findRegion(map, addr);
+  Region * r = &map->regions[k];
+  if (result & CACHE_HIT) r->hits++;
+  if (op == 'M') r->hits++;
+  if (result & CACHE_MISS) {
+    unsigned setInd = (addr >> map->b) & (map->S - 1);
+    r->misses++;
+    map->setMisses[setInd * (map->n + 1) + k]++;
+    if (k < map->n) {
+      unsigned long elem = (addr - r->base) / r->elemSize;
+      int row = elem / r->cols / r->tile;
+      int col = elem % r->cols / r->tile;
+      r->tileMisses[row * r->gridCols + col]++;
     }
   }
-  return ind;
+  if (result & CACHE_EVICT) {
+    unsigned setInd = (addr >> map->b) & (map->S - 1);
+    map->setEvictions[setInd]++;
+    map->regions[findRegion(map, cacheVictim(cache))].evictedBy[k]++;
+  }
+}
+
+void printRegions(RegionMap * map) {
+  int n = map->n;
+  printf("\nAccesses by region:\n");
+  printf("%-12s %10s %10s\n", "region", "hits", "misses");
+  for (int i = 0; i <= n; i++) {
+    Region * r = &map->regions[i];
+    printf("%-12s %10ld %10ld\n", r->name, r->hits, r->misses);
+  }
+
+  for (int i = 0; i < n; i++) {
+    Region * r = &map->regions[i];
+    printf("\nMisses of %s per %dx%d tile (rows: first row of the tile, columns: first column):\n",
+	   r->name, r->tile, r->tile);
+    printf("%6s", "");
+    for (int c = 0; c < r->gridCols; c++) printf(" %5d", c * r->tile);
+    printf("\n");
+    for (int row = 0; row < r->gridRows; row++) {
+      printf("%6d", row * r->tile);
+      for (int c = 0; c < r->gridCols; c++) printf(" %5ld", r->tileMisses[row * r->gridCols + c]);
+      printf("\n");
+    }
+  }
+
+  printf("\nEvictions (rows: region of the evicted block, columns: region of the access):\n");
+  printf("%-12s", "");
+  for (int j = 0; j <= n; j++) printf(" %10s", map->regions[j].name);
+  printf("\n");
+  for (int i = 0; i <= n; i++) {
+    printf("%-12s", map->regions[i].name);
+    for (int j = 0; j <= n; j++) printf(" %10ld", map->regions[i].evictedBy[j]);
+    printf("\n");
+  }
+
+  printf("\nMisses per set (sets without misses are omitted):\n");
+  printf("%8s", "set");
+  for (int j = 0; j <= n; j++) printf(" %10s", map->regions[j].name);
+  printf(" %10s\n", "evictions");
+  for (int set = 0; set < map->S; set++) {
+    long * row = &map->setMisses[set * (n + 1)];
+    long total = 0;
+    for (int j = 0; j <= n; j++) total += row[j];
+    if (total == 0) continue;
+    printf("%8d", set);
+    for (int j = 0; j <= n; j++) printf(" %10ld", row[j]);
+    printf(" %10ld\n", map->setEvictions[set]);
+  }
+}
+
+/*
+ * Sampled simulation
+ *
+ * Sets never interact, so simulating only some of them gives their
+ * counts exactly, at a fraction of the cost. One set in rate is picked by
+ * a hash of its index, so the picks do not line up with power-of-two
+ * strides of the trace. With time sampling, only the first window of
+ * every period records is simulated; the cache is stale at the start of
+ * each window, so the first warmup records of it update the cache
+ * without being counted. The counts of each sampled set in each window
+ * are a sample of the counts of all sets in all windows, from which the
+ * totals are extrapolated with a 95% confidence interval.
+ */
+typedef struct sampler_st {
+  unsigned rate;
+  unsigned long window, period, warmup;
+  int nsets;
+  int nsampled;
+  unsigned char * sampled;// If each set is simulated
+  unsigned long * unit;// Hits, misses and evictions of each set in this window
+  unsigned long units;// Sampled set and window pairs counted
+  double sum[3], sumSq[3];// Over those pairs
+} Sampler;
+
+// Parse rate[:window:period[:warmup]], returns 0 if invalid
+int initSampler(Sampler * sm, const char * spec, int s) {
+  unsigned long window = 0, period = 0, warmup = 0;
+  char extra;
+  int n = sscanf(spec, "%u:%lu:%lu:%lu%c", &sm->rate, &window, &period, &warmup, &extra);
+  if (n < 1 || n == 2 || n > 4 || sm->rate < 1) return 0;
+  if (n >= 3 && (window < 1 || period < window || warmup >= window)) return 0;
+  sm->window = window;
+  sm->period = period;
+  sm->warmup = warmup;
+  sm->nsets = 1 << s;
+  sm->sampled = calloc(sm->nsets, 1);
+  sm->nsampled = 0;
+  for (int set = 0; set < sm->nsets; set++) {
+    unsigned long h = (set + 1) * 0x9e3779b97f4a7c15UL;
+    h ^= h >> 31;
+    h *= 0xbf58476d1ce4e5b9UL;
+    h ^= h >> 29;
+    if (h % sm->rate == 0) {
+      sm->sampled[set] = 1;
+      sm->nsampled++;
+    }
+  }
+  // A rate above the number of sets still simulates one
+  if (sm->nsampled == 0) {
+    sm->sampled[0] = 1;
+    sm->nsampled = 1;
+  }
+  sm->unit = calloc((size_t)sm->nsets * 3, sizeof(unsigned long));
+  sm->units = 0;
+  memset(sm->sum, 0, sizeof(sm->sum));
+  memset(sm->sumSq, 0, sizeof(sm->sumSq));
+  return 1;
+}
+
+// Two-sided 95% critical value of Student's t with df degrees of freedom
+double tCritical(double df) {
+  static const double table[] = {12.71, 4.30, 3.18, 2.78, 2.57, 2.45, 2.36, 2.31, 2.26, 2.23,
+				 2.20, 2.18, 2.16, 2.14, 2.13, 2.12, 2.11, 2.10, 2.09, 2.09,
+				 2.08, 2.07, 2.07, 2.06, 2.06, 2.06, 2.05, 2.05, 2.05, 2.04};
+  if (df < 1) return table[0];
+  if (df <= 30) return table[(int)df - 1];
+  return 1.96;
+}
+
+void freeSampler(Sampler * sm) {
+  free(sm->sampled);
+  free(sm->unit);
+}
+
+// Add the counts of every sampled set in the window that ends to the sample
+void closeWindow(Sampler * sm) {
+  for (int set = 0; set < sm->nsets; set++) {
+    if (!sm->sampled[set]) continue;
+    unsigned long * u = &sm->unit[set * 3];
+    for (int k = 0; k < 3; k++) {
+      sm->sum[k] += u[k];
+      sm->sumSq[k] += (double)u[k] * u[k];
+      u[k] = 0;
+    }
+    sm->units++;
+  }
+}
+
+// Simulate the sampled part of the trace in fileStr, returns 0 on failure
+int simulateSampled(const char * fileStr, int s, int E, int b, const char * policy,
+		    const char * spec) {
+  Sampler sm;
+  if (!initSampler(&sm, spec, s)) {
+    printf("Invalid sampling \"%s\", expected rate[:window:period[:warmup]]\n", spec);
+    return 0;
+  }
+  int fd = open(fileStr, O_RDONLY);
+  if (fd < 0) {
+    printf("Unable to open file \"%s\"\n", fileStr);
+    freeSampler(&sm);
+    return 0;
+  }
+  struct stat st;
+  if (fstat(fd, &st) < 0) {
+    close(fd);
+    freeSampler(&sm);
+    return 0;
+  }
+  size_t size = st.st_size;
+  const char * trace = "";
+  if (size > 0) {
+    trace = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (trace == MAP_FAILED) {
+      printf("Unable to map file \"%s\"\n", fileStr);
+      close(fd);
+      freeSampler(&sm);
+      return 0;
+    }
+  }
+  close(fd);
+
+  cache_t * cache = cacheCreate(s, E, b, policy);
+  const char * pos = trace;
+  const char * end = trace + size;
+  char op;
+  unsigned long addr;
+  unsigned sz;
+  cache_split_t sp;
+  unsigned long records = 0;// Records of the trace
+  unsigned long counted = 0;// Records in the counted part of the windows
+  while (parseRecord(&pos, end, &op, &addr, &sz)) {
+    unsigned long phase = sm.period ? records % sm.period : 0;
+    records++;
+    if (sm.period && phase >= sm.window) continue;
+    int count = phase >= sm.warmup;
+    if (count) counted++;
+    cacheSplitInit(&sp, b, addr, sz);
+    while (cacheSplitNext(&sp)) {
+      int set = sp.block & (sm.nsets - 1);
+      if (!sm.sampled[set]) continue;
+      int result = cacheAccess(cache, op, sp.start, sp.size);
+      if (!count) continue;
+      unsigned long * u = &sm.unit[set * 3];
+      u[0] += ((result & CACHE_HIT) != 0) + (op == 'M');
+      u[1] += (result & CACHE_MISS) != 0;
+      u[2] += (result & CACHE_EVICT) != 0;
+    }
+    if (sm.period && phase == sm.window - 1) closeWindow(&sm);
+  }
+  // The last window, if the trace ends inside it
+  if (!sm.period || (records % sm.period > sm.warmup && records % sm.period < sm.window)) {
+    closeWindow(&sm);
+  }
+
+  if (counted == 0) {
+    printf("Nothing to extrapolate: the trace ended within the first %lu records, "
+	   "which only warm the cache\n", sm.warmup);
+    cacheFree(cache);
+    freeSampler(&sm);
+    if (size > 0) munmap((void *)trace, size);
+    return 0;
+  }
+
+  // Every set in every window is a unit, of which units were sampled
+  double scale = (double)sm.nsets / sm.nsampled * records / counted;
+  double n = sm.units, N = n * scale;
+  double total[3], half[3];
+  for (int k = 0; k < 3; k++) {
+    total[k] = sm.sum[k] * scale;
+    half[k] = 0;
+    if (n > 1 && N > n) {
+      double mean = sm.sum[k] / n;
+      double var = (sm.sumSq[k] - n * mean * mean) / (n - 1);
+      if (var < 0) var = 0;
+      half[k] = tCritical(n - 1) * N * sqrt(var / n * (1 - n / N));
+    }
+  }
+  printSummary((unsigned long)(total[0] + 0.5), (unsigned long)(total[1] + 0.5),
+	       (unsigned long)(total[2] + 0.5));
+  printf("sampled sets:%d/%d records:%lu/%lu\n", sm.nsampled, sm.nsets, counted, records);
+  if (N <= n) {
+    printf("95%% confidence: exact, every set and record was counted\n");
+  } else if (n <= 1) {
+    // The spread of a single unit is unknown
+    printf("95%% confidence: unknown, the sample is one set in one window; "
+	   "sample more sets or windows\n");
+  } else {
+    printf("95%% confidence: hits:%.0f-%.0f misses:%.0f-%.0f evictions:%.0f-%.0f\n",
+	   total[0] - half[0] > 0 ? total[0] - half[0] : 0, total[0] + half[0],
+	   total[1] - half[1] > 0 ? total[1] - half[1] : 0, total[1] + half[1],
+	   total[2] - half[2] > 0 ? total[2] - half[2] : 0, total[2] + half[2]);
+  }
+
+  cacheFree(cache);
+  freeSampler(&sm);
+  if (size > 0) munmap((void *)trace, size);
+  return 1;
+}
+
+/*
+ * Multicore simulation
+ *
+ * Each trace file holds the accesses of one core. A record may start
+ * with a decimal time stamp ("120 L 7ff000,4"); records without one are
+ * stamped with their position in their trace, which interleaves the
+ * cores round-robin. The records of all cores are merged in time order,
+ * ties going to the lower core.
+ */
+#define MAX_CORES 64
+#define TOP_LINES 20
+
+typedef struct corereader_st {
+  FILE * fptr;
+  unsigned long count;// Records read so far
+  int valid;// If the fields below hold the next record
+  unsigned long time;
+  char op;
+  unsigned long addr;
+  unsigned size;
+} CoreReader;
+
+// Read the next memory access of a core, skipping instruction records
+void nextCoreRecord(CoreReader * r) {
+  char buf[256];
+  r->valid = 0;
+  while (fgets(buf, sizeof(buf), r->fptr) != NULL) {
+    char * p = buf;
+    while (*p == ' ' || *p == '\t') p++;
+    r->count++;
+    r->time = r->count;
+    if (*p >= '0' && *p <= '9') r->time = strtoul(p, &p, 10);
+    if (sscanf(p, " %c %lx,%u", &r->op, &r->addr, &r->size) != 3) continue;
+    if (r->op == 'L' || r->op == 'S' || r->op == 'M') {
+      r->valid = 1;
+      return;
+    }
+  }
+}
+
+// Simulate one core per trace under a coherence protocol, returns 0 on failure
+int simulateCoherent(char * * files, int ncores, int s, int E, int b, int moesi,
+		     const char * llcStr, const char * policy) {
+  cache_t * llc = NULL;
+  if (llcStr) {
+    int ls, lE, lb;
+    if (sscanf(llcStr, "%d:%d:%d", &ls, &lE, &lb) != 3 || lb != b ||
+	(llc = cacheCreate(ls, lE, lb, policy)) == NULL) {
+      printf("Invalid LLC \"%s\", expected s:E:b with the block size of the L1s\n", llcStr);
+      return 0;
+    }
+  }
+  CoreReader * readers = calloc(ncores, sizeof(CoreReader));
+  for (int c = 0; c < ncores; c++) {
+    readers[c].fptr = fopen(files[c], "r");
+    if (readers[c].fptr == NULL) {
+      printf("Unable to open file \"%s\"\n", files[c]);
+      return 0;
+    }
+    nextCoreRecord(&readers[c]);
+  }
+
+  coherence_t * coh = coherenceCreate(ncores, s, E, b, moesi, llc);
+  while (1) {
+    CoreReader * next = NULL;
+    int core = 0;
+    for (int c = 0; c < ncores; c++) {
+      if (readers[c].valid && (next == NULL || readers[c].time < next->time)) {
+	next = &readers[c];
+	core = c;
+      }
+    }
+    if (next == NULL) break;
+    coherenceAccess(coh, core, next->op, next->addr, next->size);
+    nextCoreRecord(next);
+  }
+
+  cache_stats_t stats;
+  coherenceTotals(coh, &stats);
+  printSummary(stats.hits, stats.misses, stats.evictions);
+  coherenceReport(coh, stdout, TOP_LINES);
+
+  coherenceFree(coh);
+  if (llc) cacheFree(llc);
+  for (int c = 0; c < ncores; c++) {
+    fclose(readers[c].fptr);
+  }
+  free(readers);
+  return 1;
 }
 
 // Helper function that prints out the usage of the program
 void printUsage(char * arg) {
-  printf("\nUsage: %s [-hv] -s <s> -E <E> -b <b> -t <tracefile>\n\n", arg);
+  printf("\nUsage: %s [-hv] -s <s> -E <E> -b <b> -t <tracefile> [-p <policy>] [-j <threads>] [-a] [-r <regionfile>]\n", arg);
+  printf("       %*s [-P <prefetcher>] [-T <tlb>] [-A <timing> [-L <s:E:b>]]\n", (int)strlen(arg), "");
+  printf("       %s -S <sampling> -s <s> -E <E> -b <b> -t <tracefile> [-p <policy>]\n", arg);
+  printf("       %s -C <mesi|moesi> [-L <s:E:b>] -s <s> -E <E> -b <b> -t <trace0> -t <trace1> ...\n", arg);
+  printf("\nReplacement policies:");
+  for (int i = 0; cachePolicyName(i) != NULL; i++) {
+    printf(" %s", cachePolicyName(i));
+  }
+  printf(" (default: lru)\n");
+  printf("Accesses that straddle a block boundary access every block they touch\n");
+  printf("With -j, sets are split among threads that simulate them in parallel\n");
+  printf("With -a, misses are classified as compulsory, capacity or conflict\n");
+  printf("and a histogram of reuse distances is printed\n");
+  printf("With -r, hits, misses and evictions are attributed to the regions of\n");
+  printf("the region map (such as the .regions file written by tracegen)\n");
+  printf("With -P, a prefetcher is simulated, one of next[:degree[:latency]],\n");
+  printf("stride[:degree[:latency]] and stream[:depth[:latency[:buffers]]]\n");
+  printf("With -C, each trace is one core with a private cache, kept coherent\n");
+  printf("by the protocol over a shared LLC of geometry -L (default: none)\n");
+  printf("With -T, a TLB is simulated as well, described by\n");
+  printf("page[:l1entries:l1ways[:l2entries:l2ways]] (default: 64:4:1536:12),\n");
+  printf("where page is 4k or 2m for one page size, or 2m=lo-hi[,lo-hi...] for\n");
+  printf("2MB pages in those hex address ranges and 4KB pages elsewhere; an\n");
+  printf("access is translated once per page it touches, each l2 miss is a walk\n");
+  printf("With -A, cycles and the average memory access time are estimated from\n");
+  printf("l1hit[:l2hit[:memory[:bandwidth[:mshrs]]]] (default: 4:12:200:16:10),\n");
+  printf("latencies in cycles and bandwidth in bytes per cycle, with an L2 of\n");
+  printf("geometry -L behind the cache (default: none)\n");
+  printf("With -S, one set in rate is simulated and the totals are extrapolated,\n");
+  printf("with 95%% confidence intervals, from rate[:window:period[:warmup]]; with\n");
+  printf("a window, only the first window records of every period are simulated,\n");
+  printf("the first warmup of them without being counted\n\n");
 }
 
 int main(int argc, char * * argv) {
@@ -42,9 +883,21 @@ int main(int argc, char * * argv) {
   int E = 0;// Number of lines per set
   int b = 0;// Number of block bits
   int verbose = 0;
+  int nthreads = 1;
+  int analyze = 0;
+  char * regionStr = NULL;
+  char * prefetchStr = NULL;
+  char * tlbStr = NULL;
+  char * timingStr = NULL;
+  char * samplingStr = NULL;
   char * fileStr = NULL;
+  char * traceFiles[MAX_CORES];// One trace per core with -C
+  int ntraces = 0;
+  char * protocolStr = NULL;
+  char * llcStr = NULL;
+  const char * policy = "lru";
   char ch;
-  while ((ch = getopt(argc, argv, "hvs:E:b:t:")) != EOF) {
+  while ((ch = getopt(argc, argv, "hvs:E:b:t:p:j:ar:P:C:L:T:A:S:")) != EOF) {
     switch (ch) {
     case 's':
       s = atoi(optarg);
@@ -57,6 +910,38 @@ int main(int argc, char * * argv) {
       break;
     case 't':
       fileStr = optarg;
+      if (ntraces < MAX_CORES) traceFiles[ntraces] = optarg;
+      ntraces++;
+      break;
+    case 'C':
+      protocolStr = optarg;
+      break;
+    case 'L':
+      llcStr = optarg;
+      break;
+    case 'p':
+      policy = optarg;
+      break;
+    case 'j':
+      nthreads = atoi(optarg);
+      break;
+    case 'a':
+      analyze = 1;
+      break;
+    case 'r':
+      regionStr = optarg;
+      break;
+    case 'P':
+      prefetchStr = optarg;
+      break;
+    case 'T':
+      tlbStr = optarg;
+      break;
+    case 'A':
+      timingStr = optarg;
+      break;
+    case 'S':
+      samplingStr = optarg;
       break;
     case 'v':
       verbose = 1;
@@ -74,16 +959,89 @@ int main(int argc, char * * argv) {
     printUsage(argv[0]);
     return(EXIT_FAILURE);
   }
-  int S = (1 << s);
-  // Initiates the data structure for the cache
-  Cache cache = malloc(S * sizeof(Set));
-  for (int i = 0; i < S; i++) {
-    cache[i] = malloc(E * sizeof(Line));
-    for (int j = 0; j < E; j++) {
-      cache[i][j].valid = 0;
-      cache[i][j].timeStamp = 0;
+  if (protocolStr) {
+    int moesi = (strcmp(protocolStr, "moesi") == 0);
+    if ((!moesi && strcmp(protocolStr, "mesi") != 0) || ntraces > MAX_CORES ||
+	nthreads != 1 || verbose || analyze || regionStr || prefetchStr || tlbStr || timingStr || samplingStr) {
+      printf("Coherence simulation needs -C mesi or -C moesi, at most %d traces\n", MAX_CORES);
+      printf("and no -j, -v, -a, -r, -P, -T, -A or -S\n");
+      return(EXIT_FAILURE);
     }
+    int ok = simulateCoherent(traceFiles, ntraces, s, E, b, moesi, llcStr, policy);
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
   }
+  if (ntraces > 1) {
+    printf("Several traces can only be simulated with -C\n");
+    return(EXIT_FAILURE);
+  }
+  // Check the policy and geometry once before any thread creates its cache
+  cache_t * cache = cacheCreate(s, E, b, policy);
+  if (cache == NULL) {
+    printf("Unknown replacement policy \"%s\" or one that does not support E=%d\n", policy, E);
+    printUsage(argv[0]);
+    return(EXIT_FAILURE);
+  }
+  if (samplingStr) {
+    cacheFree(cache);
+    if (nthreads != 1 || verbose || analyze || regionStr || prefetchStr || tlbStr || timingStr) {
+      // Prefetches and the timing model cross sets, the rest needs every access
+      printf("Sampled simulation needs no -j, -v, -a, -r, -P, -T or -A\n");
+      return(EXIT_FAILURE);
+    }
+    return simulateSampled(fileStr, s, E, b, policy, samplingStr) ? EXIT_SUCCESS : EXIT_FAILURE;
+  }
+  if (nthreads < 1 || (nthreads > 1 && (verbose || analyze || regionStr || prefetchStr || tlbStr || timingStr))) {
+    // Prefetches cross sets, so sets simulated by different threads would interact
+    printf("Parallel simulation needs a positive thread count and no -v, -a, -r, -P, -T or -A\n");
+    return(EXIT_FAILURE);
+  }
+  if (llcStr && !timingStr) {
+    printf("An L2 of -L is only simulated with -C or -A\n");
+    return(EXIT_FAILURE);
+  }
+  if (prefetchStr && !cachePrefetch(cache, prefetchStr)) {
+    printf("Invalid prefetcher \"%s\"\n", prefetchStr);
+    printUsage(argv[0]);
+    return(EXIT_FAILURE);
+  }
+  tlb_t * tlb = NULL;
+  if (tlbStr && (tlb = tlbCreate(tlbStr)) == NULL) {
+    printf("Invalid TLB \"%s\"\n", tlbStr);
+    printUsage(argv[0]);
+    return(EXIT_FAILURE);
+  }
+  timing_t * timing = NULL;
+  if (timingStr && (timing = timingCreate(timingStr, b)) == NULL) {
+    printf("Invalid timing \"%s\"\n", timingStr);
+    printUsage(argv[0]);
+    return(EXIT_FAILURE);
+  }
+  // The L2 is filled by the misses of the cache, and only matters for timing
+  cache_t * l2 = NULL;
+  if (llcStr) {
+    int ls, lE, lb;
+    if (sscanf(llcStr, "%d:%d:%d", &ls, &lE, &lb) != 3 || lb != b ||
+	(l2 = cacheCreate(ls, lE, lb, policy)) == NULL) {
+      printf("Invalid L2 \"%s\", expected s:E:b with the block size of the cache\n", llcStr);
+      return(EXIT_FAILURE);
+    }
+  }
+  // The result values to be returned
+  cache_stats_t stats;
+  memset(&stats, 0, sizeof(stats));
+
+  if (nthreads > 1) {
+    cacheFree(cache);
+    if (!simulateParallel(fileStr, nthreads, s, E, b, policy, &stats))
+      return(EXIT_FAILURE);
+    printSummary(stats.hits, stats.misses, stats.evictions);
+    if (stats.splits) printf("split accesses:%lu\n", stats.splits);
+    return(EXIT_SUCCESS);
+  }
+  Analysis analysis;
+  if (analyze) initAnalysis(&analysis, (unsigned long)(1 << s) * E);
+  RegionMap regions;
+  if (regionStr && !loadRegions(&regions, regionStr, s, b)) return(EXIT_FAILURE);
 
   // Open the trace file
   FILE * fptr = fopen(fileStr, "r");
@@ -95,82 +1053,77 @@ int main(int argc, char * * argv) {
   char op;// Type of operation on memory in the trace file
   unsigned long addr;// 64-bit hexadecimal memory address
   unsigned size;// Number of bytes accessed by the operation
+  unsigned long splits = 0;// Accesses that straddle a block boundary
+  cache_split_t sp;// The blocks of the access
 
-  // The result values to be returned
-  int timeHit = 0, timeMiss = 0, timeEvict = 0;
-  
   while (fscanf(fptr, " %c %lx,%d\n", &op, &addr, &size) != EOF) {
     // If the operation is "I", ignore it
     if (op == 'I') continue;
-    
-    unsigned long tag = addr >> (s + b);
-    unsigned setInd = (addr >> b) & ((1 << s) - 1);
-
-    Set set = cache[setInd];// Reference to the set we are dealing with
-    int hit = 0;// Indicator if we have encountered a hit
 
     if (verbose) printf("%c %lx,%d ", op, addr, size);
 
-    // Update the time stamp for each of the lines in the cache
-    for (int i = 0; i < S; i++) {
-      for (int j = 0; j < E; j++) {
-	(cache[i][j].timeStamp)++;
+    // Translated once per page, but one cache access per block touched
+    if (tlb) tlbAccess(tlb, op, addr, size);
+    cacheSplitInit(&sp, b, addr, size);
+    while (cacheSplitNext(&sp)) {
+      int result = cacheAccess(cache, op, sp.start, sp.size);
+      if (timing) {
+	int l2Result = -1;
+	if (l2 && (result & CACHE_MISS)) l2Result = cacheAccess(l2, 'L', sp.start, 1);
+	timingAccess(timing, op, sp.start, result, l2Result);
       }
-    }
-    // For 'M', 'L' and 'S' operations
-    // Search through all lines in the set to see if we have a hit
-    // If we have a hit, great, update the hit counter and reset the time stamp
-    for (int i = 0; i < E; i++) {
-      if (set[i].valid && set[i].tag == tag) {
-	hit = 1;
-	// Refresh the time stamp now to indicate that we have recently used this line
-	set[i].timeStamp = 0;
-	if (verbose) printf("hit ");
-	timeHit++;
-	break;
+      if (analyze) analyzeAccess(&analysis, sp.block, result);
+      if (regionStr) attributeAccess(&regions, cache, op, sp.start, result);
+      if (verbose) {
+	if (result & CACHE_HIT) printf("hit ");
+	if (result & CACHE_MISS) printf("miss ");
+	if (result & CACHE_EVICT) printf("eviction ");
+	if (op == 'M') printf("hit ");
       }
     }
-    // If we don't have a hit
-    if (!hit) {
-      if (verbose) printf("miss ");
-      timeMiss++;
-      // Find if there exists a line in the set with valid bit not set.
-      int spareLine = -1;
-      for (int i = 0; i < E; i++) {
-	if (!set[i].valid) {
-	  spareLine = i;
-	  break;
-	}
-      }
-      // If there is, update that line
-      if (spareLine != -1) {
-	set[spareLine].valid = 1;
-	set[spareLine].tag = tag;
-	set[spareLine].timeStamp = 0;
-      }
-      // If all lines are occupied, we need to evict a least recently used line
-      else {
-	int lru = findLRU(set, E);
-	set[lru].tag = tag;
-	set[lru].timeStamp = 0;
-	if (verbose) printf("eviction ");
-	timeEvict++;
-      }
-    }
-    // For operation 'M', there must be a hit after the first store operation
-    if (op == 'M') {
-      if (verbose) printf("hit ");
-      timeHit++;
-    }
+    if (sp.pieces > 1) splits++;
     if (verbose) printf("\n");
   }
-  printSummary(timeHit, timeMiss, timeEvict);
+  cacheStats(cache, &stats);
+  stats.splits = splits;
+  printSummary(stats.hits, stats.misses, stats.evictions);
+  if (stats.splits) printf("split accesses:%lu\n", stats.splits);
+  if (prefetchStr) {
+    printf("prefetches:%lu useful:%lu late:%lu useless:%lu\n",
+	   stats.prefetches, stats.useful, stats.late, stats.useless);
+  }
+  if (tlb) {
+    tlb_stats_t ts;
+    tlbStats(tlb, &ts);
+    printf("tlb accesses:%lu (2m pages:%lu) l1 misses:%lu l2 misses:%lu walk refs:%lu\n",
+	   ts.accesses, ts.hugeAccesses, ts.l1Misses, ts.l2Misses, ts.walkRefs);
+    tlbFree(tlb);
+  }
+  if (timing) {
+    timing_stats_t ts;
+    timingStats(timing, &ts);
+    printf("cycles:%lu amat:%.2f mshr stalls:%lu merged:%lu memory fills:%lu mlp:%.2f\n",
+	   ts.cycles, ts.accesses ? (double)ts.latency / ts.accesses : 0.0,
+	   ts.stalls, ts.merged, ts.memFills, ts.mlp);
+    timingFree(timing);
+  }
+  if (l2) {
+    cache_stats_t ls;
+    cacheStats(l2, &ls);
+    printf("l2 hits:%lu misses:%lu evictions:%lu\n", ls.hits, ls.misses, ls.evictions);
+    cacheFree(l2);
+  }
+  if (analyze) {
+    printAnalysis(&analysis);
+    freeAnalysis(&analysis);
+  }
+  if (regionStr) {
+    printRegions(&regions);
+    freeRegions(&regions);
+  }
 
   // Frees the data structure and close file before exiting
   fclose(fptr);
-  for (int i = 0; i < S; i++) {
-    free(cache[i]);
-  }
-  free(cache);
+  cacheFree(cache);
   return(EXIT_SUCCESS);
 }
@@ -0,0 +1,275 @@
+/*
+ * kernels.c - Kernels beyond transpose, scored by test-kernels
+ *
+ * Each kernel has a prototype of the form
+ * void kernel(const kernel_args_t *args);
+ * and computes what its family in cachelab.h describes. A kernel can
+ * tell that it works with kernelCheck(); test-kernels checks every
+ * kernel with it after each run.
+ *
+ * test-kernels links this file twice: once compiled with
+ * -fsanitize=thread and registerKernels renamed, to count the misses of
+ * each kernel, and once as is, to time it. Everything but
+ * registerKernels must therefore be static.
+ */
+#include "cachelab.h"
+
+/*
+ * GEMM
+ */
+
+/*
+ * Tiles of GEMM_TILE x GEMM_TILE doubles. Three of them take only 6KB,
+ * but rows of power-of-two matrices map to few sets, and 32x32 tiles
+ * conflict at n = 128 on a 32KB 8-way cache.
+ */
+#define GEMM_TILE 16
+
+/* gemm_ijk - Dot products, walking b down its columns */
+static char gemm_ijk_desc[] = "GEMM, ijk dot products";
+static void gemm_ijk(const kernel_args_t *args)
+{
+    int n = args->n;
+    const double *a = args->a, *b = args->b;
+    double *c = args->c;
+    int i, j, k;
+    double sum;
+
+    for (i = 0; i < n; i++) {
+        for (j = 0; j < n; j++) {
+            sum = 0;
+            for (k = 0; k < n; k++)
+                sum += a[i * n + k] * b[k * n + j];
+            c[i * n + j] = sum;
+        }
+    }
+}
+
+/* gemm_ikj - Rows of b scaled into rows of c, every access in row order */
+static char gemm_ikj_desc[] = "GEMM, ikj row updates";
+static void gemm_ikj(const kernel_args_t *args)
+{
+    int n = args->n;
+    const double *a = args->a, *b = args->b;
+    double *c = args->c;
+    int i, j, k;
+    double aik;
+
+    for (i = 0; i < n * n; i++)
+        c[i] = 0;
+    for (i = 0; i < n; i++) {
+        for (k = 0; k < n; k++) {
+            aik = a[i * n + k];
+            for (j = 0; j < n; j++)
+                c[i * n + j] += aik * b[k * n + j];
+        }
+    }
+}
+
+/* gemm_blocked - ikj on tiles, so the tiles of a, b and c stay cached */
+static char gemm_blocked_desc[] = "GEMM, ikj on 16x16 tiles";
+static void gemm_blocked(const kernel_args_t *args)
+{
+    int n = args->n;
+    const double *a = args->a, *b = args->b;
+    double *c = args->c;
+    int i, j, k, bi, bj, bk, iend, jend, kend;
+    double aik;
+
+    for (i = 0; i < n * n; i++)
+        c[i] = 0;
+    for (bi = 0; bi < n; bi += GEMM_TILE) {
+        iend = bi + GEMM_TILE < n ? bi + GEMM_TILE : n;
+        for (bk = 0; bk < n; bk += GEMM_TILE) {
+            kend = bk + GEMM_TILE < n ? bk + GEMM_TILE : n;
+            for (bj = 0; bj < n; bj += GEMM_TILE) {
+                jend = bj + GEMM_TILE < n ? bj + GEMM_TILE : n;
+                for (i = bi; i < iend; i++) {
+                    for (k = bk; k < kend; k++) {
+                        aik = a[i * n + k];
+                        for (j = bj; j < jend; j++)
+                            c[i * n + j] += aik * b[k * n + j];
+                    }
+                }
+            }
+        }
+    }
+}
+
+/*
+ * Stencil
+ */
+
+/* Columns per strip of stencil_blocked */
+#define STENCIL_STRIP 64
+
+/* stencil_point - One output element, the boundary is copied */
+static inline double stencil_point(const double *a, int n, int r, int c)
+{
+    const double *p = a + r * n + c;
+
+    if (r == 0 || r == n - 1 || c == 0 || c == n - 1)
+        return *p;
+    return 0.2 * (p[0] + p[-1] + p[1] + p[-n] + p[n]);
+}
+
+/* stencil_rows - Row by row, three rows of a are live at a time */
+static char stencil_rows_desc[] = "5-point stencil, row by row";
+static void stencil_rows(const kernel_args_t *args)
+{
+    int n = args->n;
+    int r, c;
+
+    for (r = 0; r < n; r++)
+        for (c = 0; c < n; c++)
+            args->b[r * n + c] = stencil_point(args->a, n, r, c);
+}
+
+/*
+ * stencil_blocked - Strips of STENCIL_STRIP columns, so the three rows
+ *     that are live span a strip instead of the whole matrix, which keeps
+ *     them cached when rows are too long for the cache
+ */
+static char stencil_blocked_desc[] = "5-point stencil, 64-column strips";
+static void stencil_blocked(const kernel_args_t *args)
+{
+    int n = args->n;
+    int r, c, bc, cend;
+
+    for (bc = 0; bc < n; bc += STENCIL_STRIP) {
+        cend = bc + STENCIL_STRIP < n ? bc + STENCIL_STRIP : n;
+        for (r = 0; r < n; r++)
+            for (c = bc; c < cend; c++)
+                args->b[r * n + c] = stencil_point(args->a, n, r, c);
+    }
+}
+
+/*
+ * Prefix sum
+ */
+
+/* Elements per block of scan_blocked, whose block sums fit in the cache */
+#define SCAN_BLOCK 1024
+
+/* scan_seq - One pass with a running sum */
+static char scan_seq_desc[] = "Prefix sum, one pass";
+static void scan_seq(const kernel_args_t *args)
+{
+    long len = (long) args->n * args->n;
+    long i, sum = 0;
+
+    for (i = 0; i < len; i++) {
+        sum += args->x[i];
+        args->y[i] = sum;
+    }
+}
+
+/*
+ * scan_blocked - Reduce, then scan: sum each block into y, then scan
+ *     each block again starting from the sum of the blocks before it.
+ *     Twice the reads of scan_seq, but the blocks are independent in
+ *     both passes, which is the structure a parallel scan needs.
+ */
+static char scan_blocked_desc[] = "Prefix sum, reduce then scan 1024-element blocks";
+static void scan_blocked(const kernel_args_t *args)
+{
+    long len = (long) args->n * args->n;
+    long i, b, end, sum, offset = 0;
+
+    /* The sum of each block, kept in its last element of y */
+    for (b = 0; b < len; b += SCAN_BLOCK) {
+        end = b + SCAN_BLOCK < len ? b + SCAN_BLOCK : len;
+        sum = 0;
+        for (i = b; i < end; i++)
+            sum += args->x[i];
+        args->y[end - 1] = sum;
+    }
+    for (b = 0; b < len; b += SCAN_BLOCK) {
+        end = b + SCAN_BLOCK < len ? b + SCAN_BLOCK : len;
+        sum = offset;
+        offset += args->y[end - 1];
+        for (i = b; i < end; i++) {
+            sum += args->x[i];
+            args->y[i] = sum;
+        }
+    }
+}
+
+/*
+ * Gather and scatter
+ */
+
+/* How many elements ahead the prefetching kernels prefetch */
+#define PREFETCH_DIST 16
+
+/* gather_direct - Random reads of a, sequential writes of c */
+static char gather_direct_desc[] = "Gather, direct";
+static void gather_direct(const kernel_args_t *args)
+{
+    long len = (long) args->n * args->n;
+    long i;
+
+    for (i = 0; i < len; i++)
+        args->c[i] = args->a[args->idx[i]];
+}
+
+/*
+ * gather_prefetch - Prefetch the element PREFETCH_DIST ahead, so its miss
+ *     overlaps with the work in between. The misses are the same as
+ *     gather_direct's (prefetches are not traced), only the time differs.
+ */
+static char gather_prefetch_desc[] = "Gather, software prefetch 16 ahead";
+static void gather_prefetch(const kernel_args_t *args)
+{
+    long len = (long) args->n * args->n;
+    long i;
+
+    for (i = 0; i < len; i++) {
+        if (i + PREFETCH_DIST < len)
+            __builtin_prefetch(&args->a[args->idx[i + PREFETCH_DIST]], 0);
+        args->c[i] = args->a[args->idx[i]];
+    }
+}
+
+/* scatter_direct - Sequential reads of a, random writes of c */
+static char scatter_direct_desc[] = "Scatter, direct";
+static void scatter_direct(const kernel_args_t *args)
+{
+    long len = (long) args->n * args->n;
+    long i;
+
+    for (i = 0; i < len; i++)
+        args->c[args->idx[i]] = args->a[i];
+}
+
+/* scatter_prefetch - As gather_prefetch, prefetching for a write */
+static char scatter_prefetch_desc[] = "Scatter, software prefetch 16 ahead";
+static void scatter_prefetch(const kernel_args_t *args)
+{
+    long len = (long) args->n * args->n;
+    long i;
+
+    for (i = 0; i < len; i++) {
+        if (i + PREFETCH_DIST < len)
+            __builtin_prefetch(&args->c[args->idx[i + PREFETCH_DIST]], 1);
+        args->c[args->idx[i]] = args->a[i];
+    }
+}
+
+/*
+ * registerKernels - Register the kernels with test-kernels
+ */
+void registerKernels()
+{
+    registerKernel(KERNEL_GEMM, gemm_ijk, gemm_ijk_desc);
+    registerKernel(KERNEL_GEMM, gemm_ikj, gemm_ikj_desc);
+    registerKernel(KERNEL_GEMM, gemm_blocked, gemm_blocked_desc);
+    registerKernel(KERNEL_STENCIL, stencil_rows, stencil_rows_desc);
+    registerKernel(KERNEL_STENCIL, stencil_blocked, stencil_blocked_desc);
+    registerKernel(KERNEL_SCAN, scan_seq, scan_seq_desc);
+    registerKernel(KERNEL_SCAN, scan_blocked, scan_blocked_desc);
+    registerKernel(KERNEL_GATHER, gather_direct, gather_direct_desc);
+    registerKernel(KERNEL_GATHER, gather_prefetch, gather_prefetch_desc);
+    registerKernel(KERNEL_SCATTER, scatter_direct, scatter_direct_desc);
+    registerKernel(KERNEL_SCATTER, scatter_prefetch, scatter_prefetch_desc);
+}
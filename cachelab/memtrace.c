@@ -0,0 +1,86 @@
+/*
+ * memtrace.c - In-process memory tracing for code compiled with
+ *     -fsanitize=thread
+ *
+ * The thread sanitizer instruments every load and store that may touch
+ * memory shared with other code with a call to __tsan_read<n> or
+ * __tsan_write<n>. Linking this file instead of the sanitizer runtime
+ * turns those calls into a memory trace, so an instrumented transpose
+ * function can be traced natively instead of under valgrind. Locals
+ * that stay in registers or never escape are not instrumented; those
+ * that are get filtered as stack accesses.
+ *
+ * This file itself must not be compiled with -fsanitize=thread.
+ */
+#include <stddef.h>
+#include "memtrace.h"
+
+static memtrace_sink_t sink = NULL;
+static void *sink_arg = NULL;
+static char *stack_top = NULL;     /* Frames of traced code lie below it */
+
+/*
+ * memtraceStart - The traced code is called from the same frame as this
+ *     function, so its frames and all deeper ones lie below ours.
+ */
+void memtraceStart(memtrace_sink_t s, void *arg)
+{
+    stack_top = __builtin_frame_address(0);
+    sink_arg = arg;
+    sink = s;
+}
+
+void memtraceStop(void)
+{
+    sink = NULL;
+}
+
+static void record(char op, void *addr, unsigned size)
+{
+    char *p = addr;
+
+    if (sink == NULL)
+        return;
+    /* Anything between the current frame and the top of the traced
+       frames is on the stack */
+    if (p >= (char *) __builtin_frame_address(0) && p < stack_top)
+        return;
+    sink(op, (unsigned long) addr, size, sink_arg);
+}
+
+/*
+ * Sanitizer entry points
+ */
+void __tsan_init(void) {}
+void __tsan_func_entry(void *pc) {}
+void __tsan_func_exit(void) {}
+
+void __tsan_read1(void *addr) { record('L', addr, 1); }
+void __tsan_read2(void *addr) { record('L', addr, 2); }
+void __tsan_read4(void *addr) { record('L', addr, 4); }
+void __tsan_read8(void *addr) { record('L', addr, 8); }
+void __tsan_read16(void *addr) { record('L', addr, 16); }
+void __tsan_write1(void *addr) { record('S', addr, 1); }
+void __tsan_write2(void *addr) { record('S', addr, 2); }
+void __tsan_write4(void *addr) { record('S', addr, 4); }
+void __tsan_write8(void *addr) { record('S', addr, 8); }
+void __tsan_write16(void *addr) { record('S', addr, 16); }
+
+void __tsan_unaligned_read2(void *addr) { record('L', addr, 2); }
+void __tsan_unaligned_read4(void *addr) { record('L', addr, 4); }
+void __tsan_unaligned_read8(void *addr) { record('L', addr, 8); }
+void __tsan_unaligned_read16(void *addr) { record('L', addr, 16); }
+void __tsan_unaligned_write2(void *addr) { record('S', addr, 2); }
+void __tsan_unaligned_write4(void *addr) { record('S', addr, 4); }
+void __tsan_unaligned_write8(void *addr) { record('S', addr, 8); }
+void __tsan_unaligned_write16(void *addr) { record('S', addr, 16); }
+
+void __tsan_read_range(void *addr, unsigned long size)
+{
+    record('L', addr, size);
+}
+
+void __tsan_write_range(void *addr, unsigned long size)
+{
+    record('S', addr, size);
+}
@@ -0,0 +1,24 @@
+/*
+ * memtrace.h - In-process memory tracing for code compiled with
+ *     -fsanitize=thread
+ */
+
+#ifndef MEMTRACE_H
+#define MEMTRACE_H
+
+/* Receives each traced access: op is 'L' or 'S' */
+typedef void (*memtrace_sink_t)(char op, unsigned long addr, unsigned size,
+                                void *arg);
+
+/*
+ * memtraceStart - Send the accesses that instrumented code called after
+ *     this point makes to static and heap memory to sink. Accesses to
+ *     the stack are ignored, the same way test-trans ignores them in
+ *     valgrind traces.
+ */
+void memtraceStart(memtrace_sink_t sink, void *arg);
+
+/* memtraceStop - Stop tracing */
+void memtraceStop(void);
+
+#endif /* MEMTRACE_H */
@@ -0,0 +1,272 @@
+/*
+ * partrans.c - Multithreaded transpose of large int matrices on a
+ *     work-stealing thread pool, see partrans.h
+ *
+ * The tasks of a job are numbered, and each worker owns a range of task
+ * numbers packed into one 64-bit word, the start in the low half and the
+ * end in the high half. The owner takes tasks from the start and thieves
+ * take the upper half, both with a compare-and-swap on the word, so no
+ * locks are needed and a task is never run twice. Tasks are never added
+ * while a job runs, so a worker is done once a pass over all the others
+ * finds nothing to steal.
+ */
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sched.h>
+#include "partrans.h"
+#include "simdtrans.h"
+
+/* Bytes per task of parCopy */
+#define COPY_CHUNK (256 * 1024)
+
+#define RANGE(lo, hi) ((uint64_t)(hi) << 32 | (uint64_t)(lo))
+#define RANGE_LO(r) ((long)((r) & 0xffffffffU))
+#define RANGE_HI(r) ((long)((r) >> 32))
+
+typedef struct worker {
+    struct tpool *pool;
+    int id;
+    pthread_t tid;
+    /* Own cache line, the word is hammered by the owner and thieves */
+    uint64_t range __attribute__((aligned(64)));
+} worker_t;
+
+struct tpool {
+    int nthreads;
+    worker_t *workers;
+    pthread_barrier_t start;    /* Workers wait here for a job */
+    pthread_barrier_t done;     /* and here once they finished it */
+    tpool_task_t task;          /* The current job, NULL to quit */
+    void *arg;
+};
+
+/* Take the next task of w's own range, returns -1 if it is empty */
+static long take(worker_t *w)
+{
+    uint64_t r = __atomic_load_n(&w->range, __ATOMIC_ACQUIRE);
+
+    while (RANGE_LO(r) < RANGE_HI(r)) {
+        uint64_t next = RANGE(RANGE_LO(r) + 1, RANGE_HI(r));
+        if (__atomic_compare_exchange_n(&w->range, &r, next, 0,
+                                        __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))
+            return RANGE_LO(r);
+    }
+    return -1;
+}
+
+/* Move the upper half of some other worker's range to w, returns 0 if
+   every range is empty */
+static int steal(worker_t *w)
+{
+    tpool_t *pool = w->pool;
+    int k;
+
+    for (k = 1; k < pool->nthreads; k++) {
+        worker_t *v = &pool->workers[(w->id + k) % pool->nthreads];
+        uint64_t r = __atomic_load_n(&v->range, __ATOMIC_ACQUIRE);
+
+        while (RANGE_LO(r) < RANGE_HI(r)) {
+            long lo = RANGE_LO(r), hi = RANGE_HI(r);
+            long mid = lo + (hi - lo) / 2;
+            if (__atomic_compare_exchange_n(&v->range, &r, RANGE(lo, mid), 0,
+                                            __ATOMIC_ACQ_REL,
+                                            __ATOMIC_ACQUIRE)) {
+                __atomic_store_n(&w->range, RANGE(mid, hi), __ATOMIC_RELEASE);
+                return 1;
+            }
+        }
+    }
+    return 0;
+}
+
+static void *work(void *arg)
+{
+    worker_t *w = arg;
+    tpool_t *pool = w->pool;
+
+    while (1) {
+        long i;
+
+        pthread_barrier_wait(&pool->start);
+        if (pool->task == NULL)
+            return NULL;
+        do {
+            while ((i = take(w)) >= 0)
+                pool->task(pool->arg, i);
+        } while (steal(w));
+        pthread_barrier_wait(&pool->done);
+    }
+}
+
+tpool_t *tpoolCreate(int nthreads)
+{
+    tpool_t *pool;
+    long ncpus = sysconf(_SC_NPROCESSORS_ONLN);
+    int t;
+
+    if (ncpus < 1)
+        ncpus = 1;
+    if (nthreads <= 0)
+        nthreads = ncpus;
+    pool = calloc(1, sizeof(tpool_t));
+    pool->nthreads = nthreads;
+    if (posix_memalign((void **)&pool->workers, 64,
+                       nthreads * sizeof(worker_t)) != 0) {
+        free(pool);
+        return NULL;
+    }
+    memset(pool->workers, 0, nthreads * sizeof(worker_t));
+    pthread_barrier_init(&pool->start, NULL, nthreads + 1);
+    pthread_barrier_init(&pool->done, NULL, nthreads + 1);
+
+    for (t = 0; t < nthreads; t++) {
+        worker_t *w = &pool->workers[t];
+        cpu_set_t cpus;
+
+        w->pool = pool;
+        w->id = t;
+        pthread_create(&w->tid, NULL, work, w);
+        CPU_ZERO(&cpus);
+        CPU_SET(t % ncpus, &cpus);
+        pthread_setaffinity_np(w->tid, sizeof(cpus), &cpus);
+    }
+    return pool;
+}
+
+void tpoolFree(tpool_t *pool)
+{
+    int t;
+
+    pool->task = NULL;
+    pthread_barrier_wait(&pool->start);
+    for (t = 0; t < pool->nthreads; t++)
+        pthread_join(pool->workers[t].tid, NULL);
+    pthread_barrier_destroy(&pool->start);
+    pthread_barrier_destroy(&pool->done);
+    free(pool->workers);
+    free(pool);
+}
+
+int tpoolThreads(const tpool_t *pool)
+{
+    return pool->nthreads;
+}
+
+void tpoolRun(tpool_t *pool, long ntasks, tpool_task_t task, void *arg)
+{
+    int n = pool->nthreads;
+    int t;
+
+    if (ntasks <= 0)
+        return;
+    for (t = 0; t < n; t++)
+        pool->workers[t].range = RANGE(ntasks * t / n, ntasks * (t + 1) / n);
+    pool->task = task;
+    pool->arg = arg;
+    pthread_barrier_wait(&pool->start);
+    pthread_barrier_wait(&pool->done);
+}
+
+/*
+ * Matrix tasks
+ *
+ * Task i of a job on a destination matrix of R x C is the block in block
+ * row i / ceil(C / SIMD_BLOCK) and block column i % ceil(C / SIMD_BLOCK),
+ * for both parAlloc and parTranspose. A worker therefore starts on a band
+ * of consecutive rows of the destination in both, and the pages of the
+ * band it writes are the ones it touched first.
+ */
+typedef struct job {
+    int kernel;
+    int rows, cols;             /* Of the destination */
+    int bcols;                  /* Blocks per row of the destination */
+    const int *src;
+    int *dst;
+    size_t bytes;
+} job_t;
+
+static void zero_block(void *arg, long i)
+{
+    job_t *job = arg;
+    int bi = i / job->bcols * SIMD_BLOCK, bj = i % job->bcols * SIMD_BLOCK;
+    int h = bi + SIMD_BLOCK < job->rows ? SIMD_BLOCK : job->rows - bi;
+    int w = bj + SIMD_BLOCK < job->cols ? SIMD_BLOCK : job->cols - bj;
+    int r;
+
+    for (r = 0; r < h; r++)
+        memset(job->dst + (size_t)(bi + r) * job->cols + bj, 0,
+               w * sizeof(int));
+}
+
+static void transpose_block(void *arg, long i)
+{
+    job_t *job = arg;
+    int bi = i / job->bcols * SIMD_BLOCK, bj = i % job->bcols * SIMD_BLOCK;
+    int h = bi + SIMD_BLOCK < job->rows ? SIMD_BLOCK : job->rows - bi;
+    int w = bj + SIMD_BLOCK < job->cols ? SIMD_BLOCK : job->cols - bj;
+
+    /* Block (bi, bj) of the destination is block (bj, bi) of the source */
+    simdTransposeRect(job->kernel, w, h,
+                      job->src + (size_t)bj * job->rows + bi, job->rows,
+                      job->dst + (size_t)bi * job->cols + bj, job->cols);
+}
+
+static void copy_chunk(void *arg, long i)
+{
+    job_t *job = arg;
+    size_t off = (size_t)i * COPY_CHUNK;
+    size_t n = job->bytes - off < COPY_CHUNK ? job->bytes - off : COPY_CHUNK;
+
+    memcpy((char *)job->dst + off, (const char *)job->src + off, n);
+}
+
+static long blocks(int n)
+{
+    return (n + SIMD_BLOCK - 1) / SIMD_BLOCK;
+}
+
+int *parAlloc(tpool_t *pool, int rows, int cols)
+{
+    job_t job;
+
+    memset(&job, 0, sizeof(job));
+    if (posix_memalign((void **)&job.dst, 4096,
+                       (size_t)rows * cols * sizeof(int)) != 0)
+        return NULL;
+    job.rows = rows;
+    job.cols = cols;
+    job.bcols = blocks(cols);
+    tpoolRun(pool, blocks(rows) * job.bcols, zero_block, &job);
+    return job.dst;
+}
+
+void parTranspose(tpool_t *pool, int kernel, int rows, int cols,
+                  const int *a, int *b)
+{
+    job_t job;
+
+    memset(&job, 0, sizeof(job));
+    job.kernel = kernel;
+    job.rows = cols;
+    job.cols = rows;
+    job.bcols = blocks(rows);
+    job.src = a;
+    job.dst = b;
+    tpoolRun(pool, blocks(cols) * job.bcols, transpose_block, &job);
+}
+
+void parCopy(tpool_t *pool, void *dst, const void *src, size_t n)
+{
+    job_t job;
+
+    memset(&job, 0, sizeof(job));
+    job.src = src;
+    job.dst = dst;
+    job.bytes = n;
+    tpoolRun(pool, (n + COPY_CHUNK - 1) / COPY_CHUNK, copy_chunk, &job);
+}
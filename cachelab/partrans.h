@@ -0,0 +1,55 @@
+/*
+ * partrans.h - Multithreaded transpose of large int matrices on a
+ *     work-stealing thread pool
+ */
+
+#ifndef PARTRANS_H
+#define PARTRANS_H
+
+#include <stddef.h>
+
+typedef struct tpool tpool_t;
+
+/* A job of ntasks independent tasks, task(arg, i) runs task i */
+typedef void (*tpool_task_t)(void *arg, long i);
+
+/*
+ * tpoolCreate - Start nthreads workers (0 for one per online CPU), each
+ *     pinned to its own CPU so that the memory it touches first stays on
+ *     its NUMA node.
+ */
+tpool_t *tpoolCreate(int nthreads);
+
+/* Stop the workers and free the pool */
+void tpoolFree(tpool_t *pool);
+
+/* Number of workers of the pool */
+int tpoolThreads(const tpool_t *pool);
+
+/*
+ * tpoolRun - Run tasks 0 to ntasks - 1 and wait for them to finish.
+ *     Worker t starts on the t-th of nthreads equal ranges of tasks, in
+ *     order, and steals half of the remaining range of another worker
+ *     once its own is empty.
+ */
+void tpoolRun(tpool_t *pool, long ntasks, tpool_task_t task, void *arg);
+
+/*
+ * parAlloc - Allocate a rows x cols matrix, and zero it with the pool so
+ *     that each page is first touched by the worker that parTranspose
+ *     starts on when the matrix is its destination. Free with free().
+ */
+int *parAlloc(tpool_t *pool, int rows, int cols);
+
+/*
+ * parTranspose - Store the transpose of the rows x cols matrix a in the
+ *     cols x rows matrix b with the pool, one SIMD_BLOCK x SIMD_BLOCK
+ *     block per task, using the tile kernel of simdtrans.h
+ */
+void parTranspose(tpool_t *pool, int kernel, int rows, int cols,
+                  const int *a, int *b);
+
+/* parCopy - memcpy n bytes with the pool, as the bandwidth ceiling */
+void parCopy(tpool_t *pool, void *dst, const void *src, size_t n);
+
+#endif /* PARTRANS_H */
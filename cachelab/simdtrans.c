@@ -0,0 +1,169 @@
+/*
+ * simdtrans.c - Blocked transpose of int matrices with SSE and AVX2
+ *     tile kernels, see simdtrans.h
+ *
+ * The AVX2 kernel is compiled with a target attribute and chosen at run
+ * time, so the file builds with the usual flags and runs on any x86-64
+ * machine. Other architectures only get the scalar kernel.
+ */
+#include <stddef.h>
+#include "simdtrans.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#define SIMD_X86
+#include <immintrin.h>
+#endif
+
+
+/* Transposes the tile at a (row stride lda) into b (row stride ldb) */
+typedef void (*tile_fn)(const int *a, size_t lda, int *b, size_t ldb);
+
+static void tile_scalar(const int *a, size_t lda, int *b, size_t ldb)
+{
+    int i, j;
+
+    for (i = 0; i < 8; i++)
+        for (j = 0; j < 8; j++)
+            b[j * ldb + i] = a[i * lda + j];
+}
+
+#ifdef SIMD_X86
+static void tile_sse(const int *a, size_t lda, int *b, size_t ldb)
+{
+    __m128i r0 = _mm_loadu_si128((const __m128i *)(a + 0 * lda));
+    __m128i r1 = _mm_loadu_si128((const __m128i *)(a + 1 * lda));
+    __m128i r2 = _mm_loadu_si128((const __m128i *)(a + 2 * lda));
+    __m128i r3 = _mm_loadu_si128((const __m128i *)(a + 3 * lda));
+
+    /* Interleave pairs of rows, then pairs of pairs */
+    __m128i t0 = _mm_unpacklo_epi32(r0, r1);
+    __m128i t1 = _mm_unpacklo_epi32(r2, r3);
+    __m128i t2 = _mm_unpackhi_epi32(r0, r1);
+    __m128i t3 = _mm_unpackhi_epi32(r2, r3);
+
+    _mm_storeu_si128((__m128i *)(b + 0 * ldb), _mm_unpacklo_epi64(t0, t1));
+    _mm_storeu_si128((__m128i *)(b + 1 * ldb), _mm_unpackhi_epi64(t0, t1));
+    _mm_storeu_si128((__m128i *)(b + 2 * ldb), _mm_unpacklo_epi64(t2, t3));
+    _mm_storeu_si128((__m128i *)(b + 3 * ldb), _mm_unpackhi_epi64(t2, t3));
+}
+
+__attribute__((target("avx2")))
+static void tile_avx2(const int *a, size_t lda, int *b, size_t ldb)
+{
+    __m256i r0 = _mm256_loadu_si256((const __m256i *)(a + 0 * lda));
+    __m256i r1 = _mm256_loadu_si256((const __m256i *)(a + 1 * lda));
+    __m256i r2 = _mm256_loadu_si256((const __m256i *)(a + 2 * lda));
+    __m256i r3 = _mm256_loadu_si256((const __m256i *)(a + 3 * lda));
+    __m256i r4 = _mm256_loadu_si256((const __m256i *)(a + 4 * lda));
+    __m256i r5 = _mm256_loadu_si256((const __m256i *)(a + 5 * lda));
+    __m256i r6 = _mm256_loadu_si256((const __m256i *)(a + 6 * lda));
+    __m256i r7 = _mm256_loadu_si256((const __m256i *)(a + 7 * lda));
+
+    /* Within each 128-bit lane, transpose 4x4 quarters of the tile */
+    __m256i t0 = _mm256_unpacklo_epi32(r0, r1);
+    __m256i t1 = _mm256_unpackhi_epi32(r0, r1);
+    __m256i t2 = _mm256_unpacklo_epi32(r2, r3);
+    __m256i t3 = _mm256_unpackhi_epi32(r2, r3);
+    __m256i t4 = _mm256_unpacklo_epi32(r4, r5);
+    __m256i t5 = _mm256_unpackhi_epi32(r4, r5);
+    __m256i t6 = _mm256_unpacklo_epi32(r6, r7);
+    __m256i t7 = _mm256_unpackhi_epi32(r6, r7);
+
+    __m256i u0 = _mm256_unpacklo_epi64(t0, t2);
+    __m256i u1 = _mm256_unpackhi_epi64(t0, t2);
+    __m256i u2 = _mm256_unpacklo_epi64(t1, t3);
+    __m256i u3 = _mm256_unpackhi_epi64(t1, t3);
+    __m256i u4 = _mm256_unpacklo_epi64(t4, t6);
+    __m256i u5 = _mm256_unpackhi_epi64(t4, t6);
+    __m256i u6 = _mm256_unpacklo_epi64(t5, t7);
+    __m256i u7 = _mm256_unpackhi_epi64(t5, t7);
+
+    /* Then swap the off-diagonal quarters across lanes */
+    _mm256_storeu_si256((__m256i *)(b + 0 * ldb), _mm256_permute2x128_si256(u0, u4, 0x20));
+    _mm256_storeu_si256((__m256i *)(b + 1 * ldb), _mm256_permute2x128_si256(u1, u5, 0x20));
+    _mm256_storeu_si256((__m256i *)(b + 2 * ldb), _mm256_permute2x128_si256(u2, u6, 0x20));
+    _mm256_storeu_si256((__m256i *)(b + 3 * ldb), _mm256_permute2x128_si256(u3, u7, 0x20));
+    _mm256_storeu_si256((__m256i *)(b + 4 * ldb), _mm256_permute2x128_si256(u0, u4, 0x31));
+    _mm256_storeu_si256((__m256i *)(b + 5 * ldb), _mm256_permute2x128_si256(u1, u5, 0x31));
+    _mm256_storeu_si256((__m256i *)(b + 6 * ldb), _mm256_permute2x128_si256(u2, u6, 0x31));
+    _mm256_storeu_si256((__m256i *)(b + 7 * ldb), _mm256_permute2x128_si256(u3, u7, 0x31));
+}
+#endif
+
+static const struct {
+    const char *name;
+    tile_fn fn;
+    int tile;
+} kernels[SIMD_KERNELS] = {
+    {"scalar", tile_scalar, 8},
+#ifdef SIMD_X86
+    {"sse", tile_sse, 4},
+    {"avx2", tile_avx2, 8},
+#else
+    {"sse", NULL, 4},
+    {"avx2", NULL, 8},
+#endif
+};
+
+const char *simdKernelName(int kernel)
+{
+    return kernels[kernel].name;
+}
+
+int simdSupported(int kernel)
+{
+    if (kernel < 0 || kernel >= SIMD_KERNELS || kernels[kernel].fn == NULL)
+        return 0;
+#ifdef SIMD_X86
+    if (kernel == SIMD_AVX2) {
+        __builtin_cpu_init();
+        return __builtin_cpu_supports("avx2");
+    }
+#endif
+    return 1;
+}
+
+int simdBest(void)
+{
+    int k = SIMD_KERNELS - 1;
+
+    while (k > SIMD_SCALAR && !simdSupported(k))
+        k--;
+    return k;
+}
+
+void simdTransposeRect(int kernel, int rows, int cols, const int *a,
+                       size_t lda, int *b, size_t ldb)
+{
+    tile_fn fn = kernels[kernel].fn;
+    int t = kernels[kernel].tile;
+    int ifull = rows / t * t, jfull = cols / t * t;
+    int i, j;
+
+    for (i = 0; i < ifull; i += t)
+        for (j = 0; j < jfull; j += t)
+            fn(a + i * lda + j, lda, b + j * ldb + i, ldb);
+
+    /* The columns right of the last full tile */
+    for (i = 0; i < rows; i++)
+        for (j = jfull; j < cols; j++)
+            b[j * ldb + i] = a[i * lda + j];
+    /* The rows below it */
+    for (i = ifull; i < rows; i++)
+        for (j = 0; j < jfull; j++)
+            b[j * ldb + i] = a[i * lda + j];
+}
+
+void simdTranspose(int kernel, int rows, int cols, const int *a, int *b)
+{
+    int bi, bj, h, w;
+
+    for (bi = 0; bi < rows; bi += SIMD_BLOCK) {
+        h = bi + SIMD_BLOCK < rows ? SIMD_BLOCK : rows - bi;
+        for (bj = 0; bj < cols; bj += SIMD_BLOCK) {
+            w = bj + SIMD_BLOCK < cols ? SIMD_BLOCK : cols - bj;
+            simdTransposeRect(kernel, h, w, a + (size_t)bi * cols + bj, cols,
+                              b + (size_t)bj * rows + bi, rows);
+        }
+    }
+}
@@ -0,0 +1,49 @@
+/*
+ * simdtrans.h - Blocked transpose of int matrices with SSE and AVX2
+ *     tile kernels, for measuring real speed rather than simulated misses
+ */
+
+#ifndef SIMDTRANS_H
+#define SIMDTRANS_H
+
+#include <stddef.h>
+
+/* Blocks of 64x64 ints, 16KB of a and 16KB of b, fill a 32KB L1 */
+#define SIMD_BLOCK 64
+
+/* Tile kernels, from slowest to fastest */
+enum {
+    SIMD_SCALAR,    /* 8x8 tiles with plain loads and stores */
+    SIMD_SSE,       /* 4x4 tiles transposed in SSE2 registers */
+    SIMD_AVX2,      /* 8x8 tiles transposed in AVX2 registers */
+    SIMD_KERNELS
+};
+
+/* Name of kernel, such as "avx2" */
+const char *simdKernelName(int kernel);
+
+/* Nonzero if kernel can run on this machine */
+int simdSupported(int kernel);
+
+/* The fastest kernel this machine supports */
+int simdBest(void);
+
+/*
+ * simdTranspose - Store the transpose of the rows x cols matrix a in the
+ *     cols x rows matrix b, both in row-major order. The matrices are cut
+ *     into blocks that fit in the L1 cache, and the blocks into tiles
+ *     that kernel transposes in registers; the edges that do not fill a
+ *     tile are transposed one element at a time. kernel must be
+ *     supported.
+ */
+void simdTranspose(int kernel, int rows, int cols, const int *a, int *b);
+
+/*
+ * simdTransposeRect - Transpose the rows x cols submatrix at a, whose
+ *     rows are lda ints apart, into the submatrix at b, whose rows are ldb
+ *     ints apart, without blocking. For blocks that fit in the cache.
+ */
+void simdTransposeRect(int kernel, int rows, int cols, const int *a,
+                       size_t lda, int *b, size_t ldb);
+
+#endif /* SIMDTRANS_H */
@@ -0,0 +1,251 @@
+/*
+ * test-kernels.c - Checks the correctness of the kernels registered by
+ *     kernels.c, and scores each one by its misses in the cache simulator
+ *     and by its wall-clock time.
+ *
+ * kernels.c is linked twice. kernels-inst.o is compiled with
+ * -fsanitize=thread, and its loads and stores are traced by memtrace.c
+ * into the simulator, as in test-trans -n. kernels.o is compiled
+ * normally and is the one that is timed. Both register their kernels in
+ * the same order, so kernel i is the same code in both.
+ */
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+#include <unistd.h>
+#include <string.h>
+#include <getopt.h>
+#include <time.h>
+#include "cachelab.h"
+#include "memtrace.h"
+#include "cachesim.h"
+
+/* Defined in cachelab.c */
+extern kernel_t kernel_list[MAX_KERNELS];
+extern int kernel_counter;
+
+/* Defined in kernels-inst.o and kernels.o */
+extern void registerKernelsTraced();
+extern void registerKernels();
+
+/* Accesses simulated at a time */
+#define TRACE_BATCH 4096
+
+/* Batches shorter than this are too coarse for the clock */
+#define MIN_BATCH_NS 1000000.0
+
+/* Globals set on the command line */
+static int s = 6, E = 8, b = 6;        /* A 32KB L1 */
+static int n = 128;
+static int family = -1;                /* All families */
+static double budget = 100e6;          /* ns of timing per kernel */
+
+struct tracebuf {
+    cache_t *cache;
+    cache_ref_t refs[TRACE_BATCH];
+    size_t len;
+};
+
+/* flush_trace - Simulate the buffered accesses */
+static void flush_trace(struct tracebuf *buf)
+{
+    cacheAccessBatch(buf->cache, buf->refs, buf->len);
+    buf->len = 0;
+}
+
+/* record_access - Buffer one access, as a memtrace sink */
+static void record_access(char op, unsigned long addr, unsigned size,
+                          void *arg)
+{
+    struct tracebuf *buf = arg;
+
+    buf->refs[buf->len].op = op;
+    buf->refs[buf->len].addr = addr;
+    buf->refs[buf->len].size = size;
+    if (++buf->len == TRACE_BATCH)
+        flush_trace(buf);
+}
+
+static double now_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+/*
+ * simulate - Run the traced kernel k on a cold cache, returns 0 if its
+ *     result is wrong
+ */
+static int simulate(const kernel_t *k, kernel_args_t *args,
+                    struct tracebuf *buf, cache_stats_t *stats)
+{
+    kernelArgsClear(k->family, args);
+    cacheReset(buf->cache);
+    buf->len = 0;
+    memtraceStart(record_access, buf);
+    (*k->func_ptr)(args);
+    memtraceStop();
+    flush_trace(buf);
+    cacheStats(buf->cache, stats);
+    return kernelCheck(k->family, args);
+}
+
+/*
+ * best_time - Best wall-clock time in ns of one run of the untraced
+ *     kernel k within the budget, or -1 if its result is wrong
+ */
+static double best_time(const kernel_t *k, kernel_args_t *args)
+{
+    double start, t, best;
+    long reps = 1, r;
+
+    kernelArgsClear(k->family, args);
+    (*k->func_ptr)(args);
+    if (!kernelCheck(k->family, args))
+        return -1;
+
+    /* Find a repetition count that makes a batch measurable */
+    while (1) {
+        t = now_ns();
+        for (r = 0; r < reps; r++)
+            (*k->func_ptr)(args);
+        t = now_ns() - t;
+        if (t >= MIN_BATCH_NS)
+            break;
+        reps *= 2;
+    }
+    best = t / reps;
+
+    start = now_ns();
+    while (now_ns() - start < budget) {
+        t = now_ns();
+        for (r = 0; r < reps; r++)
+            (*k->func_ptr)(args);
+        t = (now_ns() - t) / reps;
+        if (t < best)
+            best = t;
+    }
+    return best;
+}
+
+/*
+ * usage - Print usage info
+ */
+static void usage(char *argv[])
+{
+    printf("Usage: %s [-h] [-s <s>] [-E <E>] [-b <b>] [-n <size>] [-k <family>] [-t <ms>]\n",
+           argv[0]);
+    printf("Options:\n");
+    printf("  -h          Print this help message.\n");
+    printf("  -s <s>      Number of set index bits (default %d).\n", s);
+    printf("  -E <E>      Number of lines per set (default %d).\n", E);
+    printf("  -b <b>      Number of block offset bits (default %d).\n", b);
+    printf("  -n <size>   Side of the matrices; arrays have size^2 elements (default %d).\n", n);
+    printf("  -k <family> Only test this family:");
+    for (family = 0; family < NUM_KERNEL_FAMILIES; family++)
+        printf(" %s", kernelFamilyName(family));
+    printf("\n  -t <ms>     Time budget per kernel (default 100).\n");
+    printf("Example: %s -k gemm -n 256\n", argv[0]);
+}
+
+int main(int argc, char *argv[])
+{
+    kernel_t traced[MAX_KERNELS];
+    kernel_args_t *args[NUM_KERNEL_FAMILIES];
+    struct tracebuf *buf;
+    int ntraced, i, c, f;
+
+    while ((c = getopt(argc, argv, "hs:E:b:n:k:t:")) != -1) {
+        switch (c) {
+        case 's':
+            s = atoi(optarg);
+            break;
+        case 'E':
+            E = atoi(optarg);
+            break;
+        case 'b':
+            b = atoi(optarg);
+            break;
+        case 'n':
+            n = atoi(optarg);
+            break;
+        case 'k':
+            for (family = 0; family < NUM_KERNEL_FAMILIES; family++)
+                if (strcmp(optarg, kernelFamilyName(family)) == 0)
+                    break;
+            if (family == NUM_KERNEL_FAMILIES) {
+                printf("Unknown kernel family \"%s\"\n", optarg);
+                exit(1);
+            }
+            break;
+        case 't':
+            budget = atof(optarg) * 1e6;
+            break;
+        case 'h':
+            usage(argv);
+            exit(0);
+        default:
+            usage(argv);
+            exit(1);
+        }
+    }
+    if (s < 0 || E <= 0 || b < 0 || n < 3) {
+        usage(argv);
+        exit(1);
+    }
+
+    /* Register the traced kernels first, then the timed ones */
+    registerKernelsTraced();
+    ntraced = kernel_counter;
+    memcpy(traced, kernel_list, ntraced * sizeof(kernel_t));
+    kernel_counter = 0;
+    registerKernels();
+    assert(kernel_counter == ntraced);
+
+    buf = malloc(sizeof(struct tracebuf));
+    buf->cache = cacheCreate(s, E, b, NULL);
+    assert(buf->cache);
+    for (f = 0; f < NUM_KERNEL_FAMILIES; f++)
+        args[f] = NULL;
+
+    printf("Cache: s=%d E=%d b=%d (%d bytes), size %d\n", s, E, b,
+           (1 << s) * E * (1 << b), n);
+    printf("%-8s %-50s %10s %10s %12s\n", "family", "kernel", "misses",
+           "hits", "time (us)");
+    for (i = 0; i < kernel_counter; i++) {
+        const kernel_t *k = &kernel_list[i];
+        cache_stats_t stats;
+        double ns;
+
+        f = k->family;
+        if (family >= 0 && f != family)
+            continue;
+        if (args[f] == NULL)
+            args[f] = kernelArgsCreate(f, n);
+
+        if (!simulate(&traced[i], args[f], buf, &stats)) {
+            printf("%-8s %-50s incorrect\n", kernelFamilyName(f),
+                   k->description);
+            continue;
+        }
+        ns = best_time(k, args[f]);
+        if (ns < 0) {
+            printf("%-8s %-50s incorrect\n", kernelFamilyName(f),
+                   k->description);
+            continue;
+        }
+        printf("%-8s %-50s %10lu %10lu %12.1f\n", kernelFamilyName(f),
+               k->description, stats.misses, stats.hits, ns / 1000);
+        fflush(stdout);
+    }
+
+    for (f = 0; f < NUM_KERNEL_FAMILIES; f++)
+        if (args[f])
+            kernelArgsFree(args[f]);
+    cacheFree(buf->cache);
+    free(buf);
+    return 0;
+}
@@ -3,6 +3,7 @@
  *     student's transpose functions and records the results for their
  *     official submitted version as well.
  */
+#define _POSIX_C_SOURCE 200809L
 #include <stdio.h>
 #include <stdlib.h>
 #include <assert.h>
@@ -11,7 +12,11 @@
 #include <signal.h>
 #include <getopt.h>
 #include <sys/types.h>
+#include <sys/stat.h>
+#include <elf.h>
 #include "cachelab.h"
+#include "memtrace.h"
+#include "cachesim.h"
 #include <sys/wait.h> // fir WEXITSTATUS
 #include <limits.h> // for INT_MAX
 
@@ -32,6 +37,12 @@ extern int func_counter;
 /* Globals set on the command line */
 static int M = 0;
 static int N = 0;
+static int native = 0;
+
+/* Matrices and markers for native evaluation, laid out like in tracegen */
+volatile char MARKER_START, MARKER_END;
+static int A[MAXN][MAXN];
+static int B[MAXN][MAXN];
 
 /* The correctness and performance for the submitted transpose function */
 struct results {
@@ -41,47 +52,504 @@ struct results {
 };
 static struct results results = {-1, 0, INT_MAX};
 
+/*
+ * Parallel evaluation
+ *
+ * Each registered function is evaluated in a child process with its own
+ * scratch directory, where tracegen leaves .marker and csim-ref leaves
+ * .csim_results, so up to jobs functions are traced by valgrind at the
+ * same time. Results are cached in .trans_cache, keyed by a hash of the
+ * machine code of the function in tracegen and of the functions it calls,
+ * its description and (M, N, s, E, b), so a function that did not change
+ * is not traced again. The trace of each correct function is kept in
+ * .trans_traces under its key, and put back in trace.f<i> when its
+ * evaluation is reused.
+ */
+#define CACHE_FILE ".trans_cache"
+#define TRACE_DIR ".trans_traces"
+
+/* The outcome of evaluating one function */
+struct evaluation {
+    int flag;                   /* Exit status of tracegen, 0 if correct */
+    unsigned int hits, misses, evictions;
+};
+
+/* A cached evaluation */
+struct cached {
+    unsigned long long key;
+    struct evaluation ev;
+};
+
+/* Globals set on the command line */
+static int jobs = 0;            /* Concurrent evaluations, 0 for one per CPU */
+static int force = 0;           /* Ignore cached results */
+
+/* The functions of an executable, from its ELF symbol table */
+struct funcsym {
+    unsigned long addr;         /* Where its code can be read */
+    unsigned long size;
+    const char *name;
+    int seen;
+};
+struct image {
+    struct funcsym *syms;
+    int nsyms;
+    char *strtab;
+    unsigned char *file;        /* Contents of the file, unless it is us */
+};
+static struct image self;       /* test-trans, to name the functions */
+static struct image traced;     /* tracegen, whose code valgrind traces */
+
+/*
+ * load_image - Read the names, addresses and sizes of all functions from
+ *     the symbol table of the executable path. The code of this program
+ *     is read where it was loaded; for another, the whole file is read
+ *     and each function is found in it through its section. Returns 0 if
+ *     there is no symbol table, such as in a stripped binary, and then
+ *     nothing is cached.
+ */
+static int load_image(const char *path, struct image *img)
+{
+    int is_self = img == &self;
+    FILE *fp = fopen(path, "rb");
+    Elf64_Ehdr eh;
+    Elf64_Shdr *sh = NULL;
+    Elf64_Sym sym;
+    unsigned long self_value = 0;
+    long len;
+    int i, j, n, ok = 0;
+
+    memset(img, 0, sizeof(*img));
+    if (fp == NULL)
+        return 0;
+    if (fread(&eh, sizeof(eh), 1, fp) != 1 ||
+        memcmp(eh.e_ident, ELFMAG, SELFMAG) != 0 ||
+        eh.e_ident[EI_CLASS] != ELFCLASS64)
+        goto out;
+    sh = malloc(eh.e_shnum * sizeof(Elf64_Shdr));
+    if (fseek(fp, eh.e_shoff, SEEK_SET) != 0 ||
+        fread(sh, sizeof(Elf64_Shdr), eh.e_shnum, fp) != eh.e_shnum)
+        goto out;
+    for (i = 0; i < eh.e_shnum && sh[i].sh_type != SHT_SYMTAB; i++)
+        ;
+    if (i == eh.e_shnum)
+        goto out;
+
+    if (!is_self) {
+        if (fseek(fp, 0, SEEK_END) != 0 || (len = ftell(fp)) < 0)
+            goto out;
+        img->file = malloc(len);
+        if (fseek(fp, 0, SEEK_SET) != 0 ||
+            fread(img->file, 1, len, fp) != len)
+            goto out;
+    }
+
+    /* The string table of the symbols */
+    img->strtab = malloc(sh[sh[i].sh_link].sh_size);
+    if (fseek(fp, sh[sh[i].sh_link].sh_offset, SEEK_SET) != 0 ||
+        fread(img->strtab, 1, sh[sh[i].sh_link].sh_size, fp) !=
+        sh[sh[i].sh_link].sh_size)
+        goto out;
+
+    n = sh[i].sh_size / sizeof(Elf64_Sym);
+    img->syms = calloc(n, sizeof(struct funcsym));
+    if (fseek(fp, sh[i].sh_offset, SEEK_SET) != 0)
+        goto out;
+    for (j = 0; j < n; j++) {
+        struct funcsym *f = &img->syms[img->nsyms];
+
+        if (fread(&sym, sizeof(sym), 1, fp) != 1)
+            goto out;
+        if (ELF64_ST_TYPE(sym.st_info) != STT_FUNC || sym.st_size == 0 ||
+            sym.st_shndx == SHN_UNDEF || sym.st_shndx >= eh.e_shnum)
+            continue;
+        f->name = img->strtab + sym.st_name;
+        f->size = sym.st_size;
+        if (is_self) {
+            if (strcmp(f->name, "load_image") == 0)
+                self_value = sym.st_value;
+            f->addr = sym.st_value;
+        } else {
+            /* Where it is in the file, by its section */
+            Elf64_Shdr *sec = &sh[sym.st_shndx];
+            unsigned long off = sec->sh_offset + sym.st_value - sec->sh_addr;
+            if (sec->sh_type != SHT_PROGBITS || off + f->size > len)
+                continue;
+            f->addr = (unsigned long) img->file + off;
+        }
+        img->nsyms++;
+    }
+
+    /* Relocate our own symbols by where this function was loaded */
+    if (is_self) {
+        if (self_value == 0)
+            goto out;
+        for (j = 0; j < img->nsyms; j++)
+            img->syms[j].addr += (unsigned long) load_image - self_value;
+    }
+    ok = 1;
+out:
+    free(sh);
+    fclose(fp);
+    if (!ok)
+        img->nsyms = 0;
+    return ok;
+}
+
+/* hash_bytes - FNV-1a hash of n bytes, continuing from h */
+static unsigned long long hash_bytes(unsigned long long h, const void *p,
+                                     size_t n)
+{
+    const unsigned char *c = p;
+
+    while (n--) {
+        h ^= *c++;
+        h *= 1099511628211ULL;
+    }
+    return h;
+}
+
+/*
+ * hash_code - Hash the code of the function of img at addr and of every
+ *     function it calls directly, each once. x86-64 near calls are found
+ *     by their opcode, and only those that land on the start of a
+ *     function count, so stray 0xe8 bytes do no harm.
+ */
+static unsigned long long hash_code(struct image *img, unsigned long long h,
+                                    unsigned long addr)
+{
+    const unsigned char *code;
+    unsigned long k;
+    int i;
+
+    for (i = 0; i < img->nsyms && img->syms[i].addr != addr; i++)
+        ;
+    if (i == img->nsyms || img->syms[i].seen)
+        return h;
+    img->syms[i].seen = 1;
+    code = (const unsigned char *) addr;
+    h = hash_bytes(h, code, img->syms[i].size);
+#if defined(__x86_64__)
+    for (k = 0; k + 5 <= img->syms[i].size; k++) {
+        if (code[k] == 0xe8) {
+            int rel;
+            memcpy(&rel, code + k + 1, sizeof(rel));
+            h = hash_code(img, h, addr + k + 5 + rel);
+        }
+    }
+#endif
+    return h;
+}
+
+/*
+ * eval_key - Cache key of function i, 0 if it cannot be cached. The code
+ *     hashed is tracegen's copy of the function, the one valgrind traces,
+ *     found by the name of ours, so a stale tracegen gets its own key.
+ */
+static unsigned long long eval_key(int i, unsigned int s, unsigned int E,
+                                   unsigned int b)
+{
+    unsigned long long h = 14695981039346656037ULL;
+    unsigned int params[5] = {M, N, s, E, b};
+    const char *name = NULL;
+    int j, k;
+
+    for (j = 0; j < self.nsyms; j++)
+        if (self.syms[j].addr == (unsigned long) func_list[i].func_ptr)
+            name = self.syms[j].name;
+    if (name == NULL)
+        return 0;
+    for (j = 0; j < traced.nsyms && strcmp(traced.syms[j].name, name); j++)
+        ;
+    if (j == traced.nsyms)
+        return 0;
+    for (k = 0; k < traced.nsyms; k++)
+        traced.syms[k].seen = 0;
+    h = hash_code(&traced, h, traced.syms[j].addr);
+    h = hash_bytes(h, func_list[i].description,
+                   strlen(func_list[i].description));
+    h = hash_bytes(h, params, sizeof(params));
+    return h ? h : 1;
+}
+
+/*
+ * eval_one - Trace function i under valgrind and simulate its trace, in
+ *     the scratch directory dir. Leaves the filtered trace in trace.f<i>.
+ */
+static void eval_one(int i, const char *dir, unsigned int s, unsigned int E,
+                     unsigned int b, struct evaluation *ev)
+{
+    unsigned int len;
+    unsigned long long int marker_start, marker_end, addr;
+    char buf[1000], cmd[512], path[256];
+    int flag;
+    FILE *full_trace_fp, *part_trace_fp, *fp;
+
+    memset(ev, 0, sizeof(*ev));
+    sprintf(path, "trace.f%d", i);
+    remove(path);
+
+    /* Use valgrind to generate the trace */
+    sprintf(cmd, "cd %s && valgrind --tool=lackey --trace-mem=yes --log-fd=1 -v ../tracegen -M %d -N %d -F %d  > trace.tmp", dir, M, N, i);
+    ev->flag = WEXITSTATUS(system(cmd));
+    if (ev->flag != 0)
+        return;
+
+    /* Get the start and end marker addresses */
+    sprintf(path, "%s/.marker", dir);
+    fp = fopen(path, "r");
+    assert(fp);
+    if (fscanf(fp, "%llx %llx", &marker_start, &marker_end) != 2)
+        assert(0);
+    fclose(fp);
+
+    /* The regions are the same for every function */
+    sprintf(path, "%s/.regions", dir);
+    rename(path, ".regions");
+
+    sprintf(path, "%s/trace.tmp", dir);
+    full_trace_fp = fopen(path, "r");
+    assert(full_trace_fp);
+
+    /* Filtered trace for each transpose function goes in a separate file */
+    sprintf(path, "trace.f%d", i);
+    part_trace_fp = fopen(path, "w");
+    assert(part_trace_fp);
+
+    /* Locate trace corresponding to the trans function */
+    flag = 0;
+    while (fgets(buf, 1000, full_trace_fp) != NULL) {
+
+        /* We are only interested in memory access instructions */
+        if (buf[0]==' ' && buf[2]==' ' &&
+            (buf[1]=='S' || buf[1]=='M' || buf[1]=='L' )) {
+            sscanf(buf+3, "%llx,%u", &addr, &len);
+
+            /* If start marker found, set flag */
+            if (addr == marker_start)
+                flag = 1;
+
+            /* Valgrind creates many spurious accesses to the
+               stack that have nothing to do with the students
+               code. At the moment, we are ignoring all stack
+               accesses by using the simple filter of recording
+               accesses to only the low 32-bit portion of the
+               address space. At some point it would be nice to
+               try to do more informed filtering so that would
+               eliminate the valgrind stack references while
+               include the student stack references. */
+            if (flag && addr < 0xffffffff) {
+                fputs(buf, part_trace_fp);
+            }
+
+            /* if end marker found, stop */
+            if (addr == marker_end)
+                break;
+        }
+    }
+    fclose(part_trace_fp);
+    fclose(full_trace_fp);
+
+    /* Run the reference simulator */
+    sprintf(cmd, "cd %s && ../csim-ref -s %u -E %u -b %u -t ../trace.f%d > /dev/null",
+            dir, s, E, b, i);
+    system(cmd);
+
+    /* Collect results from the reference simulator */
+    sprintf(path, "%s/.csim_results", dir);
+    fp = fopen(path, "r");
+    assert(fp);
+    if (fscanf(fp, "%u %u %u", &ev->hits, &ev->misses, &ev->evictions) != 3)
+        assert(0);
+    fclose(fp);
+}
+
+/* remove_scratch - Remove the scratch directory of a function */
+static void remove_scratch(const char *dir)
+{
+    static const char *files[] = {"trace.tmp", ".marker", ".regions",
+                                  ".csim_results"};
+    char path[256];
+    int k;
+
+    for (k = 0; k < 4; k++) {
+        sprintf(path, "%s/%s", dir, files[k]);
+        remove(path);
+    }
+    rmdir(dir);
+}
+
+/* copy_file - Copy the file from into to, returns 0 on failure */
+static int copy_file(const char *from, const char *to)
+{
+    FILE *in, *out;
+    char buf[8192];
+    size_t n;
+    int ok;
+
+    if ((in = fopen(from, "r")) == NULL)
+        return 0;
+    if ((out = fopen(to, "w")) == NULL) {
+        fclose(in);
+        return 0;
+    }
+    while ((n = fread(buf, 1, sizeof(buf), in)) > 0)
+        if (fwrite(buf, 1, n, out) != n)
+            break;
+    ok = !ferror(in) && !ferror(out);
+    fclose(in);
+    if (fclose(out) != 0)
+        ok = 0;
+    if (!ok)
+        remove(to);
+    return ok;
+}
+
+/* load_cache - Read the cached evaluations, returns how many */
+static int load_cache(struct cached **cache)
+{
+    FILE *fp = fopen(CACHE_FILE, "r");
+    struct cached c;
+    int n = 0, cap = 0;
+
+    *cache = NULL;
+    if (fp == NULL)
+        return 0;
+    while (fscanf(fp, "%llx %d %u %u %u", &c.key, &c.ev.flag, &c.ev.hits,
+                  &c.ev.misses, &c.ev.evictions) == 5) {
+        if (n == cap) {
+            cap = cap ? 2 * cap : 64;
+            *cache = realloc(*cache, cap * sizeof(struct cached));
+        }
+        (*cache)[n++] = c;
+    }
+    fclose(fp);
+    return n;
+}
+
 /* 
  * eval_perf - Evaluate the performance of the registered transpose functions
  */
 void eval_perf(unsigned int s, unsigned int E, unsigned int b)
 {
-    int i,flag;
-    unsigned int len, hits, misses, evictions;
-    unsigned long long int marker_start, marker_end, addr;
-    char buf[1000], cmd[255];
-    char filename[128];
+    struct evaluation evs[MAX_TRANS_FUNCS];
+    unsigned long long keys[MAX_TRANS_FUNCS];
+    int cached[MAX_TRANS_FUNCS];
+    pid_t pids[MAX_TRANS_FUNCS];
+    int fds[MAX_TRANS_FUNCS];
+    struct cached *cache;
+    int ncache, running = 0, next = 0;
+    char trace[64], saved[64];
+    int i, k;
+    FILE *cache_fp;
 
     registerFunctions(); 
 
-    /* Open the complete trace file */
-    FILE* full_trace_fp;  
-    FILE* part_trace_fp; 
+    if (jobs <= 0)
+        jobs = sysconf(_SC_NPROCESSORS_ONLN);
+    if (jobs <= 0)
+        jobs = 1;
+    load_image("/proc/self/exe", &self);
+    load_image("tracegen", &traced);
+    ncache = force ? 0 : load_cache(&cache);
+    if (force)
+        cache = NULL;
+
+    /* Look up the cached evaluations, and the traces of correct ones */
+    mkdir(TRACE_DIR, 0700);
+    for (i = 0; i < func_counter; i++) {
+        keys[i] = eval_key(i, s, E, b);
+        cached[i] = 0;
+        pids[i] = 0;
+        for (k = 0; k < ncache && keys[i] != 0; k++) {
+            if (cache[k].key == keys[i]) {
+                evs[i] = cache[k].ev;
+                cached[i] = 1;
+            }
+        }
+        if (cached[i]) {
+            sprintf(trace, "trace.f%d", i);
+            sprintf(saved, "%s/%016llx", TRACE_DIR, keys[i]);
+            if (evs[i].flag != 0)
+                remove(trace);
+            else if (!copy_file(saved, trace))
+                cached[i] = 0;
+        }
+    }
+    free(cache);
 
-    /* Evaluate the performance of each registered transpose function */
+    /* Evaluate the others, up to jobs at a time */
+    fflush(stdout);
+    while (next < func_counter || running > 0) {
+        if (next < func_counter && running < jobs) {
+            char dir[64];
+            int fd[2];
+
+            i = next++;
+            if (cached[i])
+                continue;
+            sprintf(dir, ".test-trans.%d", i);
+            mkdir(dir, 0700);
+            if (pipe(fd) < 0) {
+                perror("pipe");
+                exit(1);
+            }
+            pids[i] = fork();
+            if (pids[i] < 0) {
+                perror("fork");
+                exit(1);
+            }
+            if (pids[i] == 0) {
+                close(fd[0]);
+                eval_one(i, dir, s, E, b, &evs[i]);
+                if (write(fd[1], &evs[i], sizeof(evs[i])) != sizeof(evs[i]))
+                    exit(1);
+                exit(0);
+            }
+            close(fd[1]);
+            fds[i] = fd[0];
+            running++;
+        } else {
+            pid_t pid = wait(NULL);
+            char dir[64];
+
+            for (i = 0; i < func_counter && pids[i] != pid; i++)
+                ;
+            if (i == func_counter)
+                continue;
+            sprintf(dir, ".test-trans.%d", i);
+            if (read(fds[i], &evs[i], sizeof(evs[i])) != sizeof(evs[i])) {
+                printf("Evaluation of function %d failed\n", i);
+                remove_scratch(dir);
+                exit(1);
+            }
+            close(fds[i]);
+            remove_scratch(dir);
+            running--;
+        }
+    }
 
+    /* Report in order, and remember the new evaluations */
+    cache_fp = fopen(CACHE_FILE, "a");
     for (i=0; i<func_counter; i++) {
         if (strcmp(func_list[i].description, SUBMIT_DESCRIPTION) == 0 )
             results.funcid = i; /* remember which function is the submission */
 
-
-        printf("\nFunction %d (%d total)\nStep 1: Validating and generating memory traces\n",i,func_counter);
-        /* Use valgrind to generate the trace */
-
-        sprintf(cmd, "valgrind --tool=lackey --trace-mem=yes --log-fd=1 -v ./tracegen -M %d -N %d -F %d  > trace.tmp", M, N,i);
-        flag=WEXITSTATUS(system(cmd));
-        if (0!=flag) {
-            printf("Validation error at function %d! Run ./tracegen -M %d -N %d -F %d for details.\nSkipping performance evaluation for this function.\n",flag-1,M,N,i);      
+        printf("\nFunction %d (%d total)\nStep 1: Validating and generating memory traces%s\n",
+               i, func_counter, cached[i] ? " (cached)" : "");
+        /* Not when tracegen or valgrind could not be run at all */
+        sprintf(trace, "trace.f%d", i);
+        sprintf(saved, "%s/%016llx", TRACE_DIR, keys[i]);
+        if (cache_fp && keys[i] != 0 && !cached[i] && evs[i].flag < 126 &&
+            (evs[i].flag != 0 || copy_file(trace, saved))) {
+            fprintf(cache_fp, "%016llx %d %u %u %u\n", keys[i], evs[i].flag,
+                    evs[i].hits, evs[i].misses, evs[i].evictions);
+        }
+        if (evs[i].flag != 0) {
+            printf("Validation error at function %d! Run ./tracegen -M %d -N %d -F %d for details.\nSkipping performance evaluation for this function.\n",evs[i].flag-1,M,N,i);      
             continue;
         }
 
-        /* Get the start and end marker addresses */
-        FILE* marker_fp = fopen(".marker", "r");
-        assert(marker_fp);
-        fscanf(marker_fp, "%llx %llx", &marker_start, &marker_end);
-        fclose(marker_fp);
-
-
         func_list[i].correct=1;
 
         /* Save the correctness of the transpose submission */
@@ -89,84 +557,134 @@ void eval_perf(unsigned int s, unsigned int E, unsigned int b)
             results.correct = 1;
         }
 
-        full_trace_fp = fopen("trace.tmp", "r");
-        assert(full_trace_fp);
-
-
-        /* Filtered trace for each transpose function goes in a separate file */
-        sprintf(filename, "trace.f%d", i);
-        part_trace_fp = fopen(filename, "w");
-        assert(part_trace_fp);
-    
-        /* Locate trace corresponding to the trans function */
-        flag = 0;
-        while (fgets(buf, 1000, full_trace_fp) != NULL) {
-
-            /* We are only interested in memory access instructions */
-            if (buf[0]==' ' && buf[2]==' ' &&
-                (buf[1]=='S' || buf[1]=='M' || buf[1]=='L' )) {
-                sscanf(buf+3, "%llx,%u", &addr, &len);
-        
-                /* If start marker found, set flag */
-                if (addr == marker_start)
-                    flag = 1;
-
-                /* Valgrind creates many spurious accesses to the
-                   stack that have nothing to do with the students
-                   code. At the moment, we are ignoring all stack
-                   accesses by using the simple filter of recording
-                   accesses to only the low 32-bit portion of the
-                   address space. At some point it would be nice to
-                   try to do more informed filtering so that would
-                   eliminate the valgrind stack references while
-                   include the student stack references. */
-                if (flag && addr < 0xffffffff) {
-                    fputs(buf, part_trace_fp);
-                }
-
-                /* if end marker found, close trace file */
-                if (addr == marker_end) {
-                    flag = 0;
-                    fclose(part_trace_fp);
-                    break;
-                }
-            }
-        }
-        fclose(full_trace_fp);
-
-        /* Run the reference simulator */
         printf("Step 2: Evaluating performance (s=%d, E=%d, b=%d)\n", s, E, b);
-        char cmd[255];
-        sprintf(cmd, "./csim-ref -s %u -E %u -b %u -t trace.f%d > /dev/null", 
-                s, E, b, i);
-        system(cmd);
-    
-        /* Collect results from the reference simulator */
-        FILE* in_fp = fopen(".csim_results","r");
-        assert(in_fp);
-        fscanf(in_fp, "%u %u %u", &hits, &misses, &evictions);
-        fclose(in_fp);
-        func_list[i].num_hits = hits;
-        func_list[i].num_misses = misses;
-        func_list[i].num_evictions = evictions;
+        func_list[i].num_hits = evs[i].hits;
+        func_list[i].num_misses = evs[i].misses;
+        func_list[i].num_evictions = evs[i].evictions;
         printf("func %u (%s): hits:%u, misses:%u, evictions:%u\n",
-               i, func_list[i].description, hits, misses, evictions);
+               i, func_list[i].description, evs[i].hits, evs[i].misses,
+               evs[i].evictions);
     
         /* If it is transpose_submit(), record number of misses */
         if (results.funcid == i) {
-            results.misses = misses;
+            results.misses = evs[i].misses;
         }
     }
-  
+    if (cache_fp)
+        fclose(cache_fp);
+}
+
+/*
+ * Native evaluation
+ *
+ * trans.c is linked in as trans-inst.o, compiled with -fsanitize=thread,
+ * whose load and store hooks are provided by memtrace.c. Each function
+ * runs directly in this process and its accesses are fed to the cache
+ * simulator in batches, which takes milliseconds instead of a valgrind
+ * run per function.
+ */
+#define TRACE_BATCH 4096
+
+struct tracebuf {
+    cache_t *cache;
+    cache_ref_t refs[TRACE_BATCH];
+    size_t len;
+};
+
+/* flush_trace - Simulate the buffered accesses */
+void flush_trace(struct tracebuf *buf)
+{
+    cacheAccessBatch(buf->cache, buf->refs, buf->len);
+    buf->len = 0;
+}
+
+/* record_access - Buffer one access, as a memtrace sink */
+void record_access(char op, unsigned long addr, unsigned size, void *arg)
+{
+    struct tracebuf *buf = arg;
+
+    buf->refs[buf->len].op = op;
+    buf->refs[buf->len].addr = addr;
+    buf->refs[buf->len].size = size;
+    if (++buf->len == TRACE_BATCH)
+        flush_trace(buf);
+}
+
+/* validate - Check that B is the transpose of A */
+int validate(int M, int N, int A[N][M], int B[M][N])
+{
+    int i, j;
+    for (i = 0; i < N; i++)
+        for (j = 0; j < M; j++)
+            if (A[i][j] != B[j][i])
+                return 0;
+    return 1;
+}
+
+/*
+ * eval_native - Evaluate the performance of the registered transpose
+ *     functions natively
+ */
+void eval_native(unsigned int s, unsigned int E, unsigned int b)
+{
+    int i;
+    static struct tracebuf buf;
+    cache_stats_t stats;
+
+    registerFunctions();
+    initMatrix(M, N, (int (*)[M]) A, (int (*)[N]) B);
+    buf.cache = cacheCreate(s, E, b, NULL);
+    assert(buf.cache);
+
+    for (i = 0; i < func_counter; i++) {
+        if (strcmp(func_list[i].description, SUBMIT_DESCRIPTION) == 0 )
+            results.funcid = i; /* remember which function is the submission */
+
+        printf("\nFunction %d (%d total)\nStep 1: Validating and tracing natively\n",i,func_counter);
+
+        /* The same cold cache and marker accesses that csim-ref sees */
+        cacheReset(buf.cache);
+        buf.len = 0;
+        record_access('S', (unsigned long) &MARKER_START, 1, &buf);
+        MARKER_START = 33;
+        memtraceStart(record_access, &buf);
+        (*func_list[i].func_ptr)(M, N, (int (*)[M]) A, (int (*)[N]) B);
+        memtraceStop();
+        MARKER_END = 34;
+        record_access('S', (unsigned long) &MARKER_END, 1, &buf);
+        flush_trace(&buf);
+        cacheStats(buf.cache, &stats);
+
+        if (!validate(M, N, (int (*)[M]) A, (int (*)[N]) B)) {
+            printf("Validation error at function %d!\nSkipping performance evaluation for this function.\n", i);
+            continue;
+        }
+        func_list[i].correct=1;
+        if (results.funcid == i)
+            results.correct = 1;
+
+        printf("Step 2: Evaluating performance (s=%d, E=%d, b=%d)\n", s, E, b);
+        func_list[i].num_hits = stats.hits;
+        func_list[i].num_misses = stats.misses;
+        func_list[i].num_evictions = stats.evictions;
+        printf("func %u (%s): hits:%lu, misses:%lu, evictions:%lu\n",
+               i, func_list[i].description, stats.hits, stats.misses, stats.evictions);
+        if (results.funcid == i)
+            results.misses = stats.misses;
+    }
+    cacheFree(buf.cache);
 }
 
 /*
  * usage - Print usage info
  */
 void usage(char *argv[]){
-    printf("Usage: %s [-h] -M <rows> -N <cols>\n", argv[0]);
+    printf("Usage: %s [-hnf] [-j <jobs>] -M <rows> -N <cols>\n", argv[0]);
     printf("Options:\n");
     printf("  -h          Print this help message.\n");
+    printf("  -n          Trace natively instead of with valgrind.\n");
+    printf("  -j <jobs>   Functions traced with valgrind at once (default: one per CPU)\n");
+    printf("  -f          Trace every function again, ignoring %s\n", CACHE_FILE);
     printf("  -M <rows>   Number of matrix rows (max %d)\n", MAXN);
     printf("  -N <cols>   Number of  matrix columns (max %d)\n", MAXN);
     printf("Example: %s -M 8 -N 8\n", argv[0]);       
@@ -199,7 +717,7 @@ int main(int argc, char* argv[])
 {
     char c;
 
-    while ((c = getopt(argc,argv,"M:N:h")) != -1) {
+    while ((c = getopt(argc,argv,"M:N:hnfj:")) != -1) {
         switch(c) {
         case 'M':
             M = atoi(optarg);
@@ -207,6 +725,15 @@ int main(int argc, char* argv[])
         case 'N':
             N = atoi(optarg);
             break;
+        case 'n':
+            native = 1;
+            break;
+        case 'j':
+            jobs = atoi(optarg);
+            break;
+        case 'f':
+            force = 1;
+            break;
         case 'h':
             usage(argv);
             exit(0);
@@ -243,7 +770,10 @@ int main(int argc, char* argv[])
     alarm(120);
 
     /* Check the performance of the student's transpose function */
-    eval_perf(5, 1, 5);
+    if (native)
+        eval_native(5, 1, 5);
+    else
+        eval_perf(5, 1, 5);
   
     /* Emit the results for this particular test */
     if (results.funcid == -1) {
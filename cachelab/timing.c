@@ -0,0 +1,142 @@
+/*
+ * timing.c - Timing model of a cache hierarchy with overlapping misses,
+ *            see timing.h
+ *
+ * The core issues one access per cycle, and the accesses of a trace are
+ * taken to be independent, so an access never waits for the data of an
+ * earlier one. A hit completes after the hit latency of its level. An
+ * L1 miss needs one of the MSHRs (miss status holding registers) until
+ * its block arrives; a miss to a block that is already being fetched
+ * merges into its MSHR, and when all MSHRs are busy issue stalls until
+ * the first one frees. The latency of an access runs from the cycle it
+ * could first issue, after the accesses before it, to the arrival of its
+ * data, so it includes its own stall for an MSHR but not the stalls of
+ * earlier accesses. Blocks from memory also share the memory bus, which
+ * moves bandwidth bytes per cycle, so misses that overlap in latency can
+ * still queue for bandwidth.
+ *
+ * Author: Jieyu Lu
+ * Andrew ID: jieyul1
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "cachesim.h"
+#include "timing.h"
+
+// An MSHR tracks one block being fetched
+typedef struct mshr_st {
+  unsigned long block;
+  unsigned long done;// Cycle the block arrives, free from then on
+} Mshr;
+
+struct timing {
+  unsigned l1Hit, l2Hit, memory;
+  double bandwidth;// Bytes per cycle
+  int nmshrs;
+  Mshr * mshrs;
+  int b;
+  unsigned long now;// Cycle the next access issues
+  double busFree;// Cycle the memory bus is free
+  unsigned long end;// Cycle the last access completes
+  unsigned long busyUntil;// End of the misses outstanding so far
+  unsigned long busy;// Cycles with at least one miss outstanding
+  unsigned long occupancy;// Sum of the cycles each MSHR was held
+  timing_stats_t stats;
+};
+
+timing_t * timingCreate(const char * spec, int b) {
+  unsigned l1Hit = 4, l2Hit = 12, memory = 200;
+  double bandwidth = 16;
+  int nmshrs = 10;
+  char extra;
+  int n = sscanf(spec, "%u:%u:%u:%lf:%d%c", &l1Hit, &l2Hit, &memory, &bandwidth, &nmshrs, &extra);
+  if (n < 1 || n > 5 || bandwidth <= 0 || nmshrs < 1) return NULL;
+  timing_t * t = calloc(1, sizeof(timing_t));
+  t->l1Hit = l1Hit;
+  t->l2Hit = l2Hit;
+  t->memory = memory;
+  t->bandwidth = bandwidth;
+  t->nmshrs = nmshrs;
+  t->mshrs = calloc(nmshrs, sizeof(Mshr));
+  t->b = b;
+  return t;
+}
+
+void timingFree(timing_t * t) {
+  free(t->mshrs);
+  free(t);
+}
+
+// Complete an access that could first issue at cycle ready, and issues
+// now, once cycle done comes
+static void complete(timing_t * t, unsigned long ready, unsigned long done) {
+  t->stats.accesses++;
+  t->stats.latency += done - ready;
+  if (done > t->end) t->end = done;
+  t->now++;
+}
+
+// Allocate an MSHR for a miss to block, returns the cycle the block arrives
+static unsigned long allocate(timing_t * t, unsigned long block, int l2) {
+  // The MSHR that frees first, stall for it if all are busy
+  Mshr * m = &t->mshrs[0];
+  for (int i = 1; i < t->nmshrs; i++) {
+    if (t->mshrs[i].done < m->done) m = &t->mshrs[i];
+  }
+  if (m->done > t->now) {
+    t->stats.stalls += m->done - t->now;
+    t->now = m->done;
+  }
+  unsigned long ready = t->now + t->l1Hit;
+  if (l2 >= 0) ready += t->l2Hit;
+  if (l2 < 0 || (l2 & CACHE_MISS)) {
+    // The block comes from memory over the shared bus
+    double start = ready + t->memory;
+    if (start < t->busFree) start = t->busFree;
+    t->busFree = start + (double)(1UL << t->b) / t->bandwidth;
+    ready = (unsigned long)(t->busFree + 0.5);
+    t->stats.memFills++;
+  }
+  m->block = block;
+  m->done = ready;
+  // Misses are allocated in issue order, so the cycles with any outstanding
+  // are a union of intervals sorted by their start
+  t->occupancy += ready - t->now;
+  if (t->now >= t->busyUntil) {
+    t->busy += ready - t->now;
+  } else if (ready > t->busyUntil) {
+    t->busy += ready - t->busyUntil;
+  }
+  if (ready > t->busyUntil) t->busyUntil = ready;
+  return ready;
+}
+
+void timingAccess(timing_t * t, char op, unsigned long addr, int l1, int l2) {
+  unsigned long block = addr >> t->b;
+  unsigned long ready = t->now;// Before any stall for an MSHR
+  unsigned long done;
+  // The cache installs a block at once, so an access to a block still being
+  // fetched may show as a hit, it waits for the same fill either way
+  Mshr * m = NULL;
+  for (int i = 0; i < t->nmshrs; i++) {
+    if (t->mshrs[i].done > t->now && t->mshrs[i].block == block) m = &t->mshrs[i];
+  }
+  if (m) {
+    t->stats.merged++;
+    done = m->done > t->now + t->l1Hit ? m->done : t->now + t->l1Hit;
+  } else if (l1 & CACHE_MISS) {
+    done = allocate(t, block, l2);
+  } else {
+    done = t->now + t->l1Hit;
+  }
+  complete(t, ready, done);
+  // The store of 'M' hits the block the load brought
+  if (op == 'M') complete(t, t->now, done > t->now + t->l1Hit ? done : t->now + t->l1Hit);
+}
+
+void timingStats(const timing_t * t, timing_stats_t * stats) {
+  *stats = t->stats;
+  stats->cycles = t->end > t->now ? t->end : t->now;
+  stats->mlp = t->busy ? (double)t->occupancy / t->busy : 0;
+}
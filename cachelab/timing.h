@@ -0,0 +1,44 @@
+/*
+ * timing.h - Timing model of a cache hierarchy with overlapping misses
+ */
+
+#ifndef TIMING_H
+#define TIMING_H
+
+typedef struct timing timing_t;
+
+typedef struct timing_stats {
+    unsigned long accesses;
+    unsigned long cycles;       /* from the first issue to the last completion */
+    unsigned long latency;      /* sum over all accesses of the cycles from
+                                   when each could issue to its data */
+    unsigned long stalls;       /* cycles issue waited for a free MSHR */
+    unsigned long merged;       /* accesses to a block already being fetched */
+    unsigned long memFills;     /* blocks read from memory */
+    double mlp;                 /* average outstanding misses while any are */
+} timing_stats_t;
+
+/*
+ * timingCreate - Create a timing model for blocks of 2^b bytes described
+ *     by spec,
+ *         l1hit[:l2hit[:memory[:bandwidth[:mshrs]]]]
+ *     in cycles, except bandwidth in bytes per cycle. Defaults are
+ *     4:12:200:16:10. l2hit only counts if there is an L2. Returns NULL
+ *     if spec is invalid.
+ */
+timing_t *timingCreate(const char *spec, int b);
+
+/* Free the model */
+void timingFree(timing_t *t);
+
+/*
+ * timingAccess - Account one access to addr, op is 'L', 'S' or 'M'.
+ *     l1 and l2 are the CACHE_* flags of the access in each level, l2 is
+ *     -1 without an L2 and ignored on an L1 hit.
+ */
+void timingAccess(timing_t *t, char op, unsigned long addr, int l1, int l2);
+
+/* Copy the counts so far */
+void timingStats(const timing_t *t, timing_stats_t *stats);
+
+#endif /* TIMING_H */
@@ -0,0 +1,166 @@
+/*
+ * tlb.c - A two-level TLB with 4KB and 2MB pages, see tlb.h
+ *
+ * Each level is a set-associative array of virtual page numbers with LRU
+ * replacement. A translation that misses in the L1 TLB looks in the L2
+ * TLB and fills the L1 entry; one that misses in both walks the page
+ * table, which reads one entry per level (four for a 4KB page, three for
+ * a 2MB page) and fills both levels. Pages are all of one size, or 2MB
+ * in a few ranges of addresses and 4KB elsewhere.
+ *
+ * Author: Jieyu Lu
+ * Andrew ID: jieyul1
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "tlb.h"
+
+#define SMALL_PAGE_BITS 12
+#define HUGE_PAGE_BITS 21
+#define SMALL_WALK_LEVELS 4
+#define HUGE_WALK_LEVELS 3
+#define MAX_HUGE_RANGES 16
+
+// A set-associative array of translations
+typedef struct tlbarray_st {
+  int sets, ways;
+  unsigned long * keys;// Page number + 1, 0 marks an invalid entry
+  unsigned long * stamps;// Time of last use, for LRU
+} TlbArray;
+
+struct tlb {
+  int huge;// If all pages are 2MB pages
+  int nranges;// Otherwise, the ranges of 2MB pages
+  unsigned long lo[MAX_HUGE_RANGES], hi[MAX_HUGE_RANGES];
+  TlbArray l1Small, l1Huge, l2;
+  unsigned long tick;
+  tlb_stats_t stats;
+};
+
+static int initArray(TlbArray * a, int entries, int ways) {
+  if (entries < 1 || ways < 1 || entries % ways != 0) return 0;
+  a->sets = entries / ways;
+  a->ways = ways;
+  a->keys = calloc(entries, sizeof(unsigned long));
+  a->stamps = calloc(entries, sizeof(unsigned long));
+  return 1;
+}
+
+// Look key up, refreshing it if found. Returns 1 on a hit.
+static int lookupArray(TlbArray * a, unsigned long key, unsigned long tick) {
+  unsigned long * keys = &a->keys[(key % a->sets) * a->ways];
+  for (int i = 0; i < a->ways; i++) {
+    if (keys[i] == key + 1) {
+      a->stamps[&keys[i] - a->keys] = tick;
+      return 1;
+    }
+  }
+  return 0;
+}
+
+// Insert key in place of the least recently used entry of its set
+static void insertArray(TlbArray * a, unsigned long key, unsigned long tick) {
+  size_t base = (key % a->sets) * a->ways;
+  size_t victim = base;
+  for (size_t i = base; i < base + a->ways; i++) {
+    if (a->keys[i] == 0) {
+      victim = i;
+      break;
+    }
+    if (a->stamps[i] < a->stamps[victim]) victim = i;
+  }
+  a->keys[victim] = key + 1;
+  a->stamps[victim] = tick;
+}
+
+// Parse the page sizes of spec, returns 0 if invalid
+static int parsePages(tlb_t * tlb, const char * page) {
+  if (strcmp(page, "4k") == 0) return 1;
+  if (strcmp(page, "2m") == 0) {
+    tlb->huge = 1;
+    return 1;
+  }
+  if (strncmp(page, "2m=", 3) != 0) return 0;
+  const char * p = page + 3;
+  while (1) {
+    unsigned long lo, hi;
+    int len;
+    if (tlb->nranges == MAX_HUGE_RANGES ||
+	sscanf(p, "%lx-%lx%n", &lo, &hi, &len) != 2 || lo >= hi) return 0;
+    tlb->lo[tlb->nranges] = lo >> HUGE_PAGE_BITS;
+    tlb->hi[tlb->nranges] = (hi - 1) >> HUGE_PAGE_BITS;
+    tlb->nranges++;
+    p += len;
+    if (*p == '\0') return 1;
+    if (*p++ != ',') return 0;
+  }
+}
+
+tlb_t * tlbCreate(const char * spec) {
+  char page[256];
+  int l1Entries = 64, l1Ways = 4, l2Entries = 1536, l2Ways = 12;
+  int n = sscanf(spec, "%255[^:]:%d:%d:%d:%d", page, &l1Entries, &l1Ways, &l2Entries, &l2Ways);
+  if (n < 1 || n == 2 || n == 4) return NULL;
+  tlb_t * tlb = calloc(1, sizeof(tlb_t));
+  if (!parsePages(tlb, page) ||
+      !initArray(&tlb->l1Small, l1Entries, l1Ways) ||
+      !initArray(&tlb->l1Huge, l1Entries > l1Ways ? l1Entries / 2 : l1Entries, l1Ways) ||
+      !initArray(&tlb->l2, l2Entries, l2Ways)) {
+    tlbFree(tlb);
+    return NULL;
+  }
+  return tlb;
+}
+
+void tlbFree(tlb_t * tlb) {
+  free(tlb->l1Small.keys);
+  free(tlb->l1Small.stamps);
+  free(tlb->l1Huge.keys);
+  free(tlb->l1Huge.stamps);
+  free(tlb->l2.keys);
+  free(tlb->l2.stamps);
+  free(tlb);
+}
+
+// Translate addr, in a 2MB page if huge
+static void translate(tlb_t * tlb, char op, unsigned long addr, int huge) {
+  TlbArray * l1 = huge ? &tlb->l1Huge : &tlb->l1Small;
+  unsigned long vpn = addr >> (huge ? HUGE_PAGE_BITS : SMALL_PAGE_BITS);
+  // Both page sizes share the L2 TLB, so its keys tell them apart
+  unsigned long l2Key = (vpn << 1) | huge;
+  // For operation 'M', the store finds the translation of the load
+  int accesses = op == 'M' ? 2 : 1;
+
+  tlb->tick++;
+  tlb->stats.accesses += accesses;
+  if (huge) tlb->stats.hugeAccesses += accesses;
+  if (lookupArray(l1, vpn, tlb->tick)) return;
+  tlb->stats.l1Misses++;
+  if (!lookupArray(&tlb->l2, l2Key, tlb->tick)) {
+    tlb->stats.l2Misses++;
+    tlb->stats.walkRefs += huge ? HUGE_WALK_LEVELS : SMALL_WALK_LEVELS;
+    insertArray(&tlb->l2, l2Key, tlb->tick);
+  }
+  insertArray(l1, vpn, tlb->tick);
+}
+
+void tlbAccess(tlb_t * tlb, char op, unsigned long addr, unsigned size) {
+  unsigned long end = addr + (size > 1 ? size : 1);
+  // One translation for each page the access touches
+  while (addr < end) {
+    int huge = tlb->huge;
+    for (int i = 0; i < tlb->nranges && !huge; i++) {
+      huge = (addr >> HUGE_PAGE_BITS) >= tlb->lo[i] && (addr >> HUGE_PAGE_BITS) <= tlb->hi[i];
+    }
+    translate(tlb, op, addr, huge);
+    int bits = huge ? HUGE_PAGE_BITS : SMALL_PAGE_BITS;
+    unsigned long next = ((addr >> bits) + 1) << bits;
+    if (next <= addr) break;// The last page of the address space
+    addr = next;
+  }
+}
+
+void tlbStats(const tlb_t * tlb, tlb_stats_t * stats) {
+  *stats = tlb->stats;
+}
@@ -0,0 +1,43 @@
+/*
+ * tlb.h - A two-level TLB with 4KB and 2MB pages
+ */
+
+#ifndef TLB_H
+#define TLB_H
+
+typedef struct tlb tlb_t;
+
+typedef struct tlb_stats {
+    unsigned long accesses;
+    unsigned long hugeAccesses; /* of them to 2MB pages */
+    unsigned long l1Misses;     /* translations not found in the L1 TLB */
+    unsigned long l2Misses;     /* nor in the L2 TLB, each needs a page walk */
+    unsigned long walkRefs;     /* page table entries read by the walks */
+} tlb_stats_t;
+
+/*
+ * tlbCreate - Create an empty TLB described by spec,
+ *         page[:l1entries:l1ways[:l2entries:l2ways]]
+ *     where page is 4k or 2m, the size of the pages that back the whole
+ *     trace, or 2m=lo-hi[,lo-hi...] for 2MB pages in those ranges of
+ *     hex addresses (rounded out to 2MB) and 4KB pages elsewhere. The L1
+ *     TLB has separate arrays for each page size, of l1entries for 4KB
+ *     pages and half as many for 2MB pages, the L2 TLB is shared by both
+ *     sizes. Defaults are 64:4 and 1536:12. Returns NULL if spec is
+ *     invalid.
+ */
+tlb_t *tlbCreate(const char *spec);
+
+/* Free the TLB */
+void tlbFree(tlb_t *tlb);
+
+/*
+ * Translate the addresses of an access of size bytes at addr, once for
+ * each page it touches; op is 'L', 'S' or 'M'
+ */
+void tlbAccess(tlb_t *tlb, char op, unsigned long addr, unsigned int size);
+
+/* Copy the counts of all translations so far */
+void tlbStats(const tlb_t *tlb, tlb_stats_t *stats);
+
+#endif /* TLB_H */
@@ -5,6 +5,10 @@
  * The beginning and end of each registered transpose function's trace
  * is indicated by reading from "marker" addresses. These two marker
  * addresses are recorded in file for later use.
+ *
+ * The addresses and shapes of the A and B matrices are recorded in
+ * .regions, so that "csim -r .regions" can tell which matrix, and which
+ * part of it, causes the misses.
  */
 
 #include <stdlib.h>
@@ -84,6 +88,16 @@ int main(int argc, char* argv[]){
             (unsigned long long int) &MARKER_END );
     fclose(marker_fp);
 
+    /* Record the regions of the matrices, as seen by the functions */
+    FILE* region_fp = fopen(".regions","w");
+    assert(region_fp);
+    fprintf(region_fp, "# name base rows cols elemsize\n");
+    fprintf(region_fp, "A %llx %d %d %d\n",
+            (unsigned long long int) A, N, M, (int) sizeof(int));
+    fprintf(region_fp, "B %llx %d %d %d\n",
+            (unsigned long long int) B, M, N, (int) sizeof(int));
+    fclose(region_fp);
+
     if (-1==selectedFunc) {
         /* Invoke registered transpose functions */
         for (i=0; i < func_counter; i++) {
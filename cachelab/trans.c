@@ -11,6 +11,7 @@
  * on a 1KB direct mapped cache with a block size of 32 bytes.
  */ 
 #include <stdio.h>
+#include <stdlib.h>
 #include "cachelab.h"
 #include "contracts.h"
 
@@ -181,6 +182,165 @@ void trans(int M, int N, int A[N][M], int B[M][N])
     ENSURES(is_transpose(M, N, A, B));
 }
 
+/*
+ * trans_rec - Transpose rows [r0, r1) and columns [c0, c1) of A into B.
+ *     The range is halved along its longer side until it holds at most
+ *     TRANS_REC_BASE elements, so at some depth the rows of A and B being
+ *     touched fit in the cache whatever its size and block size. 4x4 tiles
+ *     did best over 32x32, 64x64 and 61x67 on the lab cache; larger tiles
+ *     are better at 32x32 but conflict badly at 64x64. Within the base case,
+ *     the element on the diagonal of each row is written last, since on
+ *     the diagonal the rows of A and B map to the same sets.
+ */
+#define TRANS_REC_BASE 16
+
+static void trans_rec(int M, int N, int A[N][M], int B[M][N],
+                      int r0, int r1, int c0, int c1)
+{
+    int i, j, mid, diag;
+
+    if ((r1 - r0) * (c1 - c0) <= TRANS_REC_BASE) {
+        for (i = r0; i < r1; i++) {
+            diag = 0;
+            for (j = c0; j < c1; j++) {
+                if (i == j)
+                    diag = 1;
+                else
+                    B[j][i] = A[i][j];
+            }
+            if (diag)
+                B[i][i] = A[i][i];
+        }
+    } else if (r1 - r0 >= c1 - c0) {
+        mid = r0 + (r1 - r0) / 2;
+        trans_rec(M, N, A, B, r0, mid, c0, c1);
+        trans_rec(M, N, A, B, mid, r1, c0, c1);
+    } else {
+        mid = c0 + (c1 - c0) / 2;
+        trans_rec(M, N, A, B, r0, r1, c0, mid);
+        trans_rec(M, N, A, B, r0, r1, mid, c1);
+    }
+}
+
+/*
+ * trans_oblivious - Cache-oblivious recursive transpose, for comparison
+ *     with transpose_submit. The same code serves every matrix shape and
+ *     cache geometry. Note that the lab rules forbid recursion in the
+ *     graded submission.
+ */
+char trans_oblivious_desc[] = "Cache-oblivious recursive transpose";
+void trans_oblivious(int M, int N, int A[N][M], int B[M][N])
+{
+    REQUIRES(M > 0);
+    REQUIRES(N > 0);
+
+    trans_rec(M, N, A, B, 0, N, 0, M);
+
+    ENSURES(is_transpose(M, N, A, B));
+}
+
+/*
+ * trans_square_inplace - Transpose the n x n matrix C in place. Tiles
+ *     above the diagonal are swapped with their mirror tiles below it,
+ *     element by element, and tiles on the diagonal swap their two
+ *     triangles. A pair of tiles is 2 * TRANS_TILE rows of a few blocks,
+ *     so both stay in the cache while they are swapped.
+ */
+#define TRANS_TILE 8
+
+void trans_square_inplace(int n, int C[n][n])
+{
+    int bi, bj, i, j, iend, jend, tmp;
+
+    REQUIRES(n > 0);
+
+    for (bi = 0; bi < n; bi += TRANS_TILE) {
+        iend = bi + TRANS_TILE < n ? bi + TRANS_TILE : n;
+        for (bj = bi; bj < n; bj += TRANS_TILE) {
+            jend = bj + TRANS_TILE < n ? bj + TRANS_TILE : n;
+            for (i = bi; i < iend; i++) {
+                for (j = (bi == bj ? i + 1 : bj); j < jend; j++) {
+                    tmp = C[i][j];
+                    C[i][j] = C[j][i];
+                    C[j][i] = tmp;
+                }
+            }
+        }
+    }
+}
+
+/*
+ * trans_rect_inplace - Transpose the rows x cols matrix stored in C in
+ *     place, leaving the cols x rows result in C. The element at index k
+ *     of the result comes from index k * cols mod (rows * cols - 1) of
+ *     the original (the first and last elements stay put), so the
+ *     permutation is followed cycle by cycle, moving each element once.
+ *     A bit per index records which ones were already moved; the bitmap
+ *     is allocated per call, 1/32 of the size of the matrix. Returns 0,
+ *     leaving C untouched, if it cannot be allocated.
+ */
+int trans_rect_inplace(int rows, int cols, int *C)
+{
+    long last = (long)rows * cols - 1;
+    long start, k, src;
+    unsigned char *moved;
+    int tmp;
+
+    REQUIRES(rows > 0);
+    REQUIRES(cols > 0);
+
+    moved = calloc(last / 8 + 1, 1);
+    if (moved == NULL)
+        return 0;
+    for (start = 1; start < last; start++) {
+        if (moved[start / 8] & (1 << (start % 8)))
+            continue;
+        /* Pull each element of the cycle into the hole it leaves */
+        tmp = C[start];
+        k = start;
+        while (1) {
+            moved[k / 8] |= 1 << (k % 8);
+            src = k * cols % last;
+            if (src == start)
+                break;
+            C[k] = C[src];
+            k = src;
+        }
+        C[k] = tmp;
+    }
+    free(moved);
+    return 1;
+}
+
+/*
+ * trans_inplace - In-place transpose, for comparison with the out-of-place
+ *     functions. The driver passes separate A and B, so A is first copied
+ *     into B, which is then transposed in place by trans_square_inplace
+ *     or trans_rect_inplace. The copy costs the same misses in every
+ *     case, so the difference to a plain copy is what transposing in
+ *     place costs. Callers with one buffer call those two directly.
+ */
+char trans_inplace_desc[] = "In-place transpose of a copy of A in B";
+void trans_inplace(int M, int N, int A[N][M], int B[M][N])
+{
+    int *C = &B[0][0];
+    int i, j;
+
+    REQUIRES(M > 0);
+    REQUIRES(N > 0);
+
+    for (i = 0; i < N; i++)
+        for (j = 0; j < M; j++)
+            C[i * M + j] = A[i][j];
+
+    if (M == N)
+        trans_square_inplace(N, B);
+    else if (!trans_rect_inplace(N, M, C))
+        return;
+
+    ENSURES(is_transpose(M, N, A, B));
+}
+
 /*
  * registerFunctions - This function registers your transpose
  *     functions with the driver.  At runtime, the driver will
@@ -195,6 +355,8 @@ void registerFunctions()
 
     /* Register any additional transpose functions */
     registerTransFunction(trans, trans_desc); 
+    registerTransFunction(trans_oblivious, trans_oblivious_desc);
+    registerTransFunction(trans_inplace, trans_inplace_desc);
 
 }
 
@@ -0,0 +1,280 @@
+/*
+ * transbench.c - Wall-clock benchmark of the transpose kernels in
+ *     simdtrans.c
+ *
+ * For each square size from min to max, doubling, every kernel the
+ * machine supports is checked against a plain transpose and then timed.
+ * A run is repeated until it takes a measurable time, and the fastest of
+ * these batches within the time budget is reported in ns per element.
+ * With -j, the multithreaded transpose of partrans.c is timed instead,
+ * in GB/s next to a memcpy of the same size.
+ */
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <time.h>
+#include "simdtrans.h"
+#include "partrans.h"
+
+/* Batches shorter than this are too coarse for the clock */
+#define MIN_BATCH_NS 1000000.0
+
+static double now_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static void *alloc_matrix(size_t n)
+{
+    void *p;
+
+    /* Align to a cache line, as a production allocation would */
+    if (posix_memalign(&p, 64, n * n * sizeof(int)) != 0)
+        return NULL;
+    return p;
+}
+
+static void fill(int n, int *a)
+{
+    size_t i;
+
+    for (i = 0; i < (size_t)n * n; i++)
+        a[i] = (int)i;
+}
+
+/* Returns 1 if b is the transpose of the n x n matrix a */
+static int check(int n, const int *a, const int *b)
+{
+    size_t i, j;
+
+    for (i = 0; i < n; i++)
+        for (j = 0; j < n; j++)
+            if (b[j * n + i] != a[i * n + j])
+                return 0;
+    return 1;
+}
+
+/* Best time in ns of one call of run(arg) within budget ns */
+static double best_time(void (*run)(void *), void *arg, double budget)
+{
+    double start, t, best;
+    long reps = 1, r;
+
+    /* Find a repetition count that makes a batch measurable */
+    while (1) {
+        t = now_ns();
+        for (r = 0; r < reps; r++)
+            run(arg);
+        t = now_ns() - t;
+        if (t >= MIN_BATCH_NS)
+            break;
+        reps *= 2;
+    }
+    best = t / reps;
+
+    start = now_ns();
+    while (now_ns() - start < budget) {
+        t = now_ns();
+        for (r = 0; r < reps; r++)
+            run(arg);
+        t = (now_ns() - t) / reps;
+        if (t < best)
+            best = t;
+    }
+    return best;
+}
+
+typedef struct run {
+    int kernel;
+    int n;
+    const int *a;
+    int *b;
+    tpool_t *pool;
+} run_t;
+
+static void run_simd(void *arg)
+{
+    run_t *r = arg;
+
+    simdTranspose(r->kernel, r->n, r->n, r->a, r->b);
+}
+
+static void run_par(void *arg)
+{
+    run_t *r = arg;
+
+    parTranspose(r->pool, r->kernel, r->n, r->n, r->a, r->b);
+}
+
+static void run_copy(void *arg)
+{
+    run_t *r = arg;
+
+    parCopy(r->pool, r->b, r->a, (size_t)r->n * r->n * sizeof(int));
+}
+
+/*
+ * bench_parallel - Time parTranspose with kernel on nthreads threads and
+ *     a memcpy of the same size on the same threads, in GB/s of data read
+ *     plus written. The copy is the ceiling for the transpose.
+ */
+static void bench_parallel(int min, int max, int kernel, int nthreads,
+                           double budget)
+{
+    tpool_t *pool = tpoolCreate(nthreads);
+    int n;
+
+    printf("%d threads, kernel %s\n", tpoolThreads(pool),
+           simdKernelName(kernel));
+    printf("%8s %10s %10s %8s   (GB/s)\n", "size", "transpose", "memcpy",
+           "ratio");
+    for (n = min; n <= max; n *= 2) {
+        int *a = parAlloc(pool, n, n);
+        int *b = parAlloc(pool, n, n);
+        double bytes = 2.0 * n * n * sizeof(int);
+        double trans, copy;
+        run_t r;
+
+        if (a == NULL || b == NULL) {
+            printf("Unable to allocate two %dx%d matrices\n", n, n);
+            exit(1);
+        }
+        fill(n, a);
+        parTranspose(pool, kernel, n, n, a, b);
+        if (!check(n, a, b)) {
+            printf("Parallel transpose is incorrect at %dx%d\n", n, n);
+            exit(1);
+        }
+        r.kernel = kernel;
+        r.n = n;
+        r.a = a;
+        r.b = b;
+        r.pool = pool;
+        trans = bytes / best_time(run_par, &r, budget);
+        copy = bytes / best_time(run_copy, &r, budget);
+        printf("%8d %10.2f %10.2f %7.0f%%\n", n, trans, copy,
+               100 * trans / copy);
+        fflush(stdout);
+        free(a);
+        free(b);
+    }
+    tpoolFree(pool);
+}
+
+static void usage(char *argv[])
+{
+    printf("Usage: %s [-h] [-m <min>] [-M <max>] [-k <kernel>] [-t <ms>] "
+           "[-j <threads>]\n", argv[0]);
+    printf("Options:\n");
+    printf("  -h          Print this help message.\n");
+    printf("  -m <min>    Smallest matrix size (default 32)\n");
+    printf("  -M <max>    Largest matrix size (default 8192)\n");
+    printf("  -k <kernel> Only time this kernel: scalar, sse or avx2\n");
+    printf("  -t <ms>     Time budget per kernel and size (default 200)\n");
+    printf("  -j <threads> Time the multithreaded transpose in GB/s against\n"
+           "              memcpy instead, 0 for one thread per CPU\n");
+    printf("Example: %s -m 256 -M 4096 -k avx2\n", argv[0]);
+}
+
+int main(int argc, char *argv[])
+{
+    int min = 32, max = 8192, only = -1, nthreads = -1;
+    double budget = 200e6;
+    int c, k, n;
+
+    while ((c = getopt(argc, argv, "hm:M:k:t:j:")) != -1) {
+        switch (c) {
+        case 'm':
+            min = atoi(optarg);
+            break;
+        case 'M':
+            max = atoi(optarg);
+            break;
+        case 'k':
+            for (only = 0; only < SIMD_KERNELS; only++)
+                if (strcmp(optarg, simdKernelName(only)) == 0)
+                    break;
+            if (only == SIMD_KERNELS) {
+                printf("Unknown kernel \"%s\"\n", optarg);
+                exit(1);
+            }
+            break;
+        case 't':
+            budget = atof(optarg) * 1e6;
+            break;
+        case 'j':
+            nthreads = atoi(optarg);
+            if (nthreads == 0)
+                nthreads = sysconf(_SC_NPROCESSORS_ONLN);
+            break;
+        case 'h':
+            usage(argv);
+            exit(0);
+        default:
+            usage(argv);
+            exit(1);
+        }
+    }
+    if (min <= 0 || max < min) {
+        usage(argv);
+        exit(1);
+    }
+    if (only >= 0 && !simdSupported(only)) {
+        printf("Kernel %s is not supported on this machine\n",
+               simdKernelName(only));
+        exit(1);
+    }
+
+    if (nthreads > 0) {
+        bench_parallel(min, max, only >= 0 ? only : simdBest(), nthreads,
+                       budget);
+        return 0;
+    }
+
+    printf("%8s", "size");
+    for (k = 0; k < SIMD_KERNELS; k++)
+        if ((only < 0 || k == only) && simdSupported(k))
+            printf(" %10s", simdKernelName(k));
+    printf("   (ns/element)\n");
+
+    for (n = min; n <= max; n *= 2) {
+        int *a = alloc_matrix(n);
+        int *b = alloc_matrix(n);
+        run_t r;
+
+        if (a == NULL || b == NULL) {
+            printf("Unable to allocate two %dx%d matrices\n", n, n);
+            exit(1);
+        }
+        fill(n, a);
+
+        printf("%8d", n);
+        for (k = 0; k < SIMD_KERNELS; k++) {
+            if ((only >= 0 && k != only) || !simdSupported(k))
+                continue;
+            memset(b, 0, n * (size_t)n * sizeof(int));
+            simdTranspose(k, n, n, a, b);
+            if (!check(n, a, b)) {
+                printf("\nKernel %s is incorrect at %dx%d\n",
+                       simdKernelName(k), n, n);
+                exit(1);
+            }
+            r.kernel = k;
+            r.n = n;
+            r.a = a;
+            r.b = b;
+            printf(" %10.3f", best_time(run_simd, &r, budget) / n / n);
+            fflush(stdout);
+        }
+        printf("\n");
+        free(a);
+        free(b);
+    }
+    return 0;
+}
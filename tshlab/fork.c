@@ -1,5 +1,5 @@
 /*
- * fork.c - Wrapper for fork() that introduces non-determinism
+ * fork.c - Wrapper for posix_spawn() that introduces non-determinism
  *          in the order that the parent and child are executed
  */
 #include <sys/time.h>
@@ -7,6 +7,7 @@
 #include <unistd.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <spawn.h>
 
 /* Sleep for a random period between 0 and MAX_SLEEP microseconds */
 #define MAX_SLEEP 100000
@@ -15,19 +16,27 @@
 
 struct timeval time;
 
-pid_t __real_fork(void);
+int __real_posix_spawn(pid_t *pid, const char *path,
+		       const posix_spawn_file_actions_t *actions,
+		       const posix_spawnattr_t *attr,
+		       char *const argv[], char *const envp[]);
 
 /*
- * __wrap_fork - Link-time wrapper for fork() that introduces
- * non-determinism in the order that parent and child are executed.
- * After calling fork, randomly decide whether to sleep for a random
- * period in either the parent or child process, which results in
- * yielding control to the other process.  Based on a link-time
- * positioning technique: Given the -Wl,--wrap,fork argument, the linker
- * replaces all references to fork to __wrap_fork(), and all
- * references to __real_fork to fork().
+ * __wrap_posix_spawn - Link-time wrapper for posix_spawn() that
+ * introduces non-determinism in the order that parent and child are
+ * executed. The child cannot be held back, it is already running the
+ * new program when posix_spawn returns, so randomly decide whether to
+ * sleep for a random period in the parent, which yields control to
+ * the child. It may then stop or exit before the parent adds the job.
+ * Based on a link-time positioning technique: Given the
+ * -Wl,--wrap,posix_spawn argument, the linker replaces all references
+ * to posix_spawn to __wrap_posix_spawn(), and all references to
+ * __real_posix_spawn to posix_spawn().
  */
-pid_t __wrap_fork(void)
+int __wrap_posix_spawn(pid_t *pid, const char *path,
+		       const posix_spawn_file_actions_t *actions,
+		       const posix_spawnattr_t *attr,
+		       char *const argv[], char *const envp[])
 {
     gettimeofday(&time, NULL);
     srand(time.tv_usec);
@@ -35,21 +44,14 @@ pid_t __wrap_fork(void)
     unsigned bool = (unsigned)(CONVERT(rand()) + 0.5);
     unsigned secs = (unsigned)(CONVERT(rand()) * MAX_SLEEP);
 
-    /* Call the real fork function */
-    pid_t pid = __real_fork();
+    /* Call the real posix_spawn function */
+    int rc = __real_posix_spawn(pid, path, actions, attr, argv, envp);
 
-    /* Randomly decide to sleep in the parent or the child */
-    if (pid == 0) {
-	if(bool) {
-	    usleep(secs);
-	}
-    }
-    else {
-	if (!bool) {
-	    usleep(secs);
-	}
+    /* Randomly decide to sleep in the parent */
+    if (rc == 0 && bool) {
+	usleep(secs);
     }
 
-    /* Return the PID like a normal fork call */
-    return pid;
+    /* Return the error number like a normal posix_spawn call */
+    return rc;
 }
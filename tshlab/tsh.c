@@ -1,15 +1,25 @@
 /* 
  * tsh - A tiny shell program with job control
  * 
- * This program provides basic job control and I/O redirection 
- * functionality as a Unix shell. Pipe is not supported.
+ * This program provides basic job control, I/O redirection and 
+ * pipelines as a Unix shell. The commands of a pipeline run in one 
+ * process group as one job, so job control acts on all of them.
  *
- * Four built-in commands are provided:
+ * Commands without a '/' are searched for in PATH, and the paths found
+ * are remembered, as bash does.
+ *
+ * Given a script file, tsh runs its commands without prompting, skipping
+ * lines that start with '#', and waits for its background jobs before
+ * it exits, with status 1 if any job failed. With -j N, at most N jobs
+ * run in background at a time: starting another waits for one to end.
+ *
+ * Five built-in commands are provided:
  *
  * quit: quit the shell
  * jobs: list the jobs running or stopped in background
  * bg <%jid/PID>: continue running job specified by jid or PID in background. 
  * fg <%jid/PID>: continue running job specified by jid or PID on foreground. 
+ * hash [-r]: list the remembered command paths, or forget them all (-r)
  *
  * Author: Jieyu Lu     Andrew ID: jieyul1
  */
@@ -24,12 +34,16 @@
 #include <fcntl.h>
 #include <sys/wait.h>
 #include <errno.h>
+#include <spawn.h>
+#include <sys/stat.h>
+#include <sys/signalfd.h>
+#include <poll.h>
 
 /* Misc manifest constants */
 #define MAXLINE    1024   /* max line size */
 #define MAXARGS     128   /* max args on a command line */
-#define MAXJOBS      16   /* max jobs at any point in time */
-#define MAXJID    1<<16   /* max job ID */
+#define MAXSTAGES    32   /* max commands in a pipeline */
+#define MINBUCKETS   16   /* initial size of the PID hash and JID index */
 
 /* Job states */
 #define UNDEF         0   /* undefined */
@@ -58,19 +72,75 @@ extern char **environ;      /* defined in libc */
 char prompt[] = "tsh> ";    /* command line prompt (DO NOT CHANGE) */
 int verbose = 0;            /* if true, print additional output */
 int nextjid = 1;            /* next job ID to allocate */
-char sbuf[MAXLINE];         /* for composing sprintf messages */
+char sbuf[MAXLINE + 64];    /* for composing sprintf messages */
+int sigfd = -1;             /* signalfd of the event loop (-e), or -1 */
+sigset_t job_mask;          /* signal mask the shell started with */
+int cmdfd = STDIN_FILENO;   /* where commands are read from */
+int maxbg = 0;              /* limit of background jobs (-j), 0 if none */
+volatile sig_atomic_t nfailed = 0; /* jobs that failed or did not start */
+
+struct proc_t {             /* A process of a job */
+    pid_t pid;
+    int stopped;            /* if it is stopped */
+    struct job_t *job;      /* the job it belongs to */
+    struct proc_t *next;    /* next process in its PID bucket */
+};
 
 struct job_t {              /* The job struct */
-    pid_t pid;              /* job PID */
+    pid_t pid;              /* job PID, of its first process and group */
     int jid;                /* job ID [1, 2, ...] */
     int state;              /* UNDEF, BG, FG, or ST */
     char cmdline[MAXLINE];  /* command line */
+    int nprocs;             /* processes of the pipeline */
+    int live;               /* of them not reaped yet */
+    int running;            /* of them neither reaped nor stopped */
+    int status;             /* wait status of the last process */
+    struct proc_t procs[MAXSTAGES];
+    struct job_t *next;     /* next free job */
+};
+
+/*
+ * The job list has no fixed size. Jobs are found by the PID of any of
+ * their processes through a hash table with chaining and by JID through
+ * an array indexed by JID, and the foreground job is tracked, so every
+ * lookup is O(1). sigchld_handler deletes jobs, so deletion never calls
+ * free(): deleted jobs go on a free list. Only addjob, which runs with
+ * all signals blocked, allocates and grows the tables.
+ */
+struct job_list_t {
+    struct proc_t **buckets; /* PID hash table */
+    int nbuckets;           /* a power of 2 */
+    int nprocs;             /* processes in the hash table */
+    struct job_t **jids;    /* jids[jid] is the job with that JID */
+    int njids;              /* size of jids */
+    int njobs;              /* number of jobs */
+    int nbg;                /* of them running in background */
+    int maxjid;             /* largest JID in use, 0 if none */
+    struct job_t *fg;       /* the foreground job, if any */
+    struct job_t *free;     /* deleted jobs, for reuse */
+};
+struct job_list_t job_list; /* The job list */
+
+struct pathent_t {          /* A remembered command */
+    char *name;             /* as typed */
+    char *path;             /* where it was found in PATH */
+    int hits;               /* times it was run */
+    struct pathent_t *next; /* next entry in its bucket */
+};
+
+struct path_cache_t {       /* Command name -> path hash table */
+    struct pathent_t **buckets;
+    int nbuckets;           /* a power of 2, 0 before the first lookup */
+    int nentries;
+    char *path;             /* the PATH the entries were found in */
 };
-struct job_t job_list[MAXJOBS]; /* The job list */
+struct path_cache_t path_cache; /* The remembered commands */
 
 struct cmdline_tokens {
     int argc;               /* Number of arguments */
-    char *argv[MAXARGS];    /* The arguments list */
+    char *argv[MAXARGS];    /* The arguments list, NULL between commands */
+    int nstages;            /* Number of commands in the pipeline */
+    char **stages[MAXSTAGES]; /* The arguments of each command */
     char *infile;           /* The input file */
     char *outfile;          /* The output file */
     enum builtins_t {       /* Indicates if argv[0] is a builtin command */
@@ -78,7 +148,8 @@ struct cmdline_tokens {
         BUILTIN_QUIT,
         BUILTIN_JOBS,
         BUILTIN_BG,
-        BUILTIN_FG} builtins;
+        BUILTIN_FG,
+        BUILTIN_HASH} builtins;
 };
 
 /* End global variables */
@@ -86,6 +157,10 @@ struct cmdline_tokens {
 
 /* Function prototypes */
 void eval(char *cmdline);
+void waitfg(sigset_t *mask);
+void waitslot(int limit);
+int waitevents(int input);
+int readcmdline(char *cmdline);
 
 void sigchld_handler(int sig);
 void sigtstp_handler(int sig);
@@ -96,18 +171,28 @@ int parseline(const char *cmdline, struct cmdline_tokens *tok);
 void sigquit_handler(int sig);
 
 void clearjob(struct job_t *job);
-void initjobs(struct job_t *job_list);
-int maxjid(struct job_t *job_list); 
-int addjob(struct job_t *job_list, pid_t pid, int state, char *cmdline);
-int deletejob(struct job_t *job_list, pid_t pid); 
-pid_t fgpid(struct job_t *job_list);
-struct job_t *getjobpid(struct job_t *job_list, pid_t pid);
-struct job_t *getjobjid(struct job_t *job_list, int jid); 
+void initjobs(struct job_list_t *job_list);
+int maxjid(struct job_list_t *job_list); 
+int addjob(struct job_list_t *job_list, pid_t *pids, int nprocs, int state, 
+           char *cmdline);
+int deletejob(struct job_list_t *job_list, pid_t pid); 
+void setjobstate(struct job_list_t *job_list, struct job_t *job, int state);
+void continuejob(struct job_list_t *job_list, struct job_t *job, int state);
+struct proc_t *getprocpid(struct job_list_t *job_list, pid_t pid);
+void reapproc(struct job_list_t *job_list, struct proc_t *proc);
+pid_t fgpid(struct job_list_t *job_list);
+struct job_t *getjobpid(struct job_list_t *job_list, pid_t pid);
+struct job_t *getjobjid(struct job_list_t *job_list, int jid); 
 int pid2jid(pid_t pid); 
-void listjobs(struct job_t *job_list, int output_fd);
+void listjobs(struct job_list_t *job_list, int output_fd);
+
+const char *findcommand(struct path_cache_t *cache, const char *name);
+void forgetcommands(struct path_cache_t *cache, const char *name);
+void listcommands(struct path_cache_t *cache, int output_fd);
 
 void usage(void);
 void unix_error(char *msg);
+void posix_error(int code, char *msg);
 void app_error(char *msg);
 typedef void handler_t(int);
 handler_t *Signal(int signum, handler_t *handler);
@@ -122,14 +207,19 @@ main(int argc, char **argv)
 {
     char c;
     char cmdline[MAXLINE];    /* cmdline for fgets */
+    FILE *script = stdin;     /* commands, from a file or stdin */
+    size_t len;
     int emit_prompt = 1; /* emit prompt (default) */
+    int eventloop = 0;   /* handle signals in an event loop */
+    int eof;
+    sigset_t mask_events;
 
     /* Redirect stderr to stdout (so that driver will get all output
      * on the pipe connected to stdout) */
     dup2(1, 2);
 
     /* Parse the command line */
-    while ((c = getopt(argc, argv, "hvp")) != EOF) {
+    while ((c = getopt(argc, argv, "hvpej:")) != EOF) {
         switch (c) {
         case 'h':             /* print help message */
             usage();
@@ -140,17 +230,52 @@ main(int argc, char **argv)
         case 'p':             /* don't print a prompt */
             emit_prompt = 0;  /* handy for automatic testing */
             break;
+        case 'e':             /* read signals from a signalfd */
+            eventloop = 1;
+            break;
+        case 'j':             /* limit the jobs running in background */
+            if ((maxbg = atoi(optarg)) < 1)
+                usage();
+            break;
         default:
             usage();
         }
     }
+    if (optind < argc - 1)
+        usage();
+    if (optind < argc) {
+        if ((script = fopen(argv[optind], "re")) == NULL)
+            unix_error(argv[optind]);
+        cmdfd = fileno(script);
+        emit_prompt = 0;
+    }
 
     /* Install the signal handlers */
 
-    /* These are the ones you will need to implement */
-    Signal(SIGINT,  sigint_handler);   /* ctrl-c */
-    Signal(SIGTSTP, sigtstp_handler);  /* ctrl-z */
-    Signal(SIGCHLD, sigchld_handler);  /* Terminated or stopped child */
+    /* Jobs start with the signal mask of the shell, whatever it blocks */
+    sigemptyset(&mask_events);
+    if (sigprocmask(SIG_BLOCK, &mask_events, &job_mask) < 0)
+        unix_error("sigprocmask error");
+
+    /* These are the ones you will need to implement. With -e they stay
+       blocked and are read from sigfd instead (see readcmdline) */
+    if (eventloop) {
+        sigaddset(&mask_events, SIGINT);
+        sigaddset(&mask_events, SIGTSTP);
+        sigaddset(&mask_events, SIGCHLD);
+        /* An ignored signal is discarded, it would never reach sigfd */
+        Signal(SIGINT,  SIG_DFL);
+        Signal(SIGTSTP, SIG_DFL);
+        Signal(SIGCHLD, SIG_DFL);
+        if (sigprocmask(SIG_BLOCK, &mask_events, NULL) < 0)
+            unix_error("sigprocmask error");
+        if ((sigfd = signalfd(-1, &mask_events, SFD_NONBLOCK|SFD_CLOEXEC)) < 0)
+            unix_error("signalfd error");
+    } else {
+        Signal(SIGINT,  sigint_handler);   /* ctrl-c */
+        Signal(SIGTSTP, sigtstp_handler);  /* ctrl-z */
+        Signal(SIGCHLD, sigchld_handler);  /* Terminated or stopped child */
+    }
     Signal(SIGTTIN, SIG_IGN);
     Signal(SIGTTOU, SIG_IGN);
 
@@ -158,7 +283,7 @@ main(int argc, char **argv)
     Signal(SIGQUIT, sigquit_handler); 
 
     /* Initialize the job list */
-    initjobs(job_list);
+    initjobs(&job_list);
 
 
     /* Execute the shell's read/eval loop */
@@ -168,18 +293,37 @@ main(int argc, char **argv)
             printf("%s", prompt);
             fflush(stdout);
         }
-        if ((fgets(cmdline, MAXLINE, stdin) == NULL) && ferror(stdin))
-            app_error("fgets error");
-        if (feof(stdin)) { 
-            /* End of file (ctrl-d) */
-            printf ("\n");
+        if (sigfd >= 0)
+            eof = !readcmdline(cmdline);
+        else {
+            cmdline[0] = '\0';
+            if ((fgets(cmdline, MAXLINE, script) == NULL) && ferror(script))
+                app_error("fgets error");
+            eof = feof(script) && cmdline[0] == '\0';
+        }
+        if (eof) { 
+            if (script == stdin) {
+                /* End of file (ctrl-d) */
+                printf ("\n");
+                fflush(stdout);
+                fflush(stderr);
+                exit(0);
+            }
+            /* End of the script, once its background jobs are done */
+            waitslot(1);
             fflush(stdout);
             fflush(stderr);
-            exit(0);
+            exit(nfailed ? 1 : 0);
         }
         
-        /* Remove the trailing newline */
-        cmdline[strlen(cmdline)-1] = '\0';
+        /* Remove the trailing newline, if the line has one */
+        len = strlen(cmdline);
+        if (len > 0 && cmdline[len-1] == '\n')
+            cmdline[len-1] = '\0';
+        
+        /* Skip comments, and the #! line, of a script */
+        if (script != stdin && cmdline[strspn(cmdline, " \t")] == '#')
+            continue;
         
         /* Evaluate the command line */
         eval(cmdline);
@@ -195,13 +339,6 @@ main(int argc, char **argv)
  * Process control wrapper functions
  * (Adapted from csapp.c)
  ***********************************/
-pid_t Fork(void) {
-  pid_t pid;
-  if ((pid = fork()) < 0)
-    unix_error("Fork error");
-  return pid;
-}
-
 void Kill(pid_t pid, int signum) {
   int rc;
   if ((rc = kill(pid, signum)) < 0)
@@ -261,6 +398,15 @@ void Close(int fd) {
     unix_error("Close error");
 }
 
+/* Pipe - pipe(2) with both ends close-on-exec */
+void Pipe(int fds[2]) {
+  if (pipe(fds) < 0)
+    unix_error("Pipe error");
+  if (fcntl(fds[0], F_SETFD, FD_CLOEXEC) < 0 || 
+      fcntl(fds[1], F_SETFD, FD_CLOEXEC) < 0)
+    unix_error("Fcntl error");
+}
+
 int Dup2(int fd1, int fd2) {
   int rc;
   if ((rc = dup2(fd1, fd2)) < 0)
@@ -268,6 +414,84 @@ int Dup2(int fd1, int fd2) {
   return rc;
 }
 
+/*******************************
+ * Job launch with posix_spawn
+ *******************************/
+
+/*
+ * spawnproc - Start the command argv in process group pgid, or in a new
+ *     group of its own if pgid is 0
+ *
+ * glibc implements posix_spawn with clone(CLONE_VM|CLONE_VFORK), so the
+ * child shares the shell's memory until it calls execve and the page
+ * tables of the shell are never copied, which fork would do for every
+ * job. Everything the child used to do between fork and execve is
+ * described by spawn attributes instead: the process group, the
+ * signal mask from before SIGCHLD was blocked, default actions for the
+ * signals the shell ignores, and the redirection of stdin/stdout to infd
+ * and outfd (-1 for none).
+ *
+ * A command without a '/' runs from where findcommand finds it. If that
+ * path was remembered and no longer works, it is forgotten and PATH is
+ * searched again.
+ *
+ * Returns the PID of the process, or 0 if the command could not be run.
+ */
+pid_t 
+spawnproc(char **argv, int infd, int outfd, pid_t pgid, sigset_t *mask) 
+{
+  posix_spawnattr_t attr;
+  posix_spawn_file_actions_t actions;
+  sigset_t defaults;
+  const char *path;
+  pid_t pid;
+  int rc;
+
+  if ((rc = posix_spawnattr_init(&attr)) != 0)
+    posix_error(rc, "posix_spawnattr_init error");
+  if ((rc = posix_spawn_file_actions_init(&actions)) != 0)
+    posix_error(rc, "posix_spawn_file_actions_init error");
+
+  Sigemptyset(&defaults);
+  Sigaddset(&defaults, SIGTTIN);
+  Sigaddset(&defaults, SIGTTOU);
+  /* With -e these are not caught, so an inherited SIG_IGN would pass on */
+  Sigaddset(&defaults, SIGINT);
+  Sigaddset(&defaults, SIGTSTP);
+  Sigaddset(&defaults, SIGQUIT);
+  Sigaddset(&defaults, SIGCHLD);
+  posix_spawnattr_setflags(&attr, POSIX_SPAWN_SETPGROUP | 
+			   POSIX_SPAWN_SETSIGMASK | POSIX_SPAWN_SETSIGDEF);
+  posix_spawnattr_setpgroup(&attr, pgid);
+  posix_spawnattr_setsigmask(&attr, mask);
+  posix_spawnattr_setsigdefault(&attr, &defaults);
+
+  /* infd and outfd are close-on-exec, their copies on 0 and 1 are not, 
+     so the child keeps no other end of a pipe open */
+  if (infd >= 0)
+    posix_spawn_file_actions_adddup2(&actions, infd, STDIN_FILENO);
+  if (outfd >= 0)
+    posix_spawn_file_actions_adddup2(&actions, outfd, STDOUT_FILENO);
+
+  path = findcommand(&path_cache, argv[0]);
+  rc = path ? posix_spawn(&pid, path, &actions, &attr, argv, environ) 
+    : ENOENT;
+  if (rc != 0 && path && path != argv[0]) {
+    forgetcommands(&path_cache, argv[0]);
+    path = findcommand(&path_cache, argv[0]);
+    rc = path ? posix_spawn(&pid, path, &actions, &attr, argv, environ) 
+      : ENOENT;
+  }
+  posix_spawn_file_actions_destroy(&actions);
+  posix_spawnattr_destroy(&attr);
+  if (rc != 0) {
+    fprintf(stderr, "%s: command not found\n", argv[0]);
+    nfailed++;
+    return 0;
+  }
+  return pid;
+}
+
 /*
  * closeFileAndRestoredFd - does the cleanup work before returning from eval
  *
@@ -291,11 +515,12 @@ void closeFileAndRestoreFd(struct cmdline_tokens * tok, int infd, int outfd,
 /* 
  * eval - Evaluate the command line that the user has just typed in
  * 
- * If the user has requested a built-in command (quit, jobs, bg or fg)
- * then execute it immediately. Otherwise, fork a child process and
- * run the job in the context of the child. If the job is running in
+ * If the user has requested a built-in command (quit, jobs, bg, fg or
+ * hash) then execute it immediately. Otherwise, spawn a child process
+ * for each command of the pipeline (see spawnproc), connected by pipes,
+ * which together are the job. If the job is running in
  * the foreground, wait for it to terminate and then return.  Note:
- * each child process must have a unique process group ID so that our
+ * each job must have a unique process group ID so that our
  * background children don't receive SIGINT (SIGTSTP) from the kernel
  * when we type ctrl-c (ctrl-z) at the keyboard.  
  */
@@ -332,24 +557,43 @@ eval(char *cmdline)
     return;
   if (tok.builtins == BUILTIN_QUIT) /* built in quit command */
     exit(0);
+  /* Only builtins redirect the shell's own stdin/stdout, 
+     a job gets the files from spawnproc */
+  infd = outfd = -1;
   if (tok.infile != NULL) {/* input redirected */
-    infd = Open(tok.infile, O_RDONLY, 0);
-    savedSTDIN_FILENO = dup(STDIN_FILENO);
-    Dup2(infd, STDIN_FILENO);
+    infd = Open(tok.infile, O_RDONLY|O_CLOEXEC, 0);
+    if (tok.builtins != BUILTIN_NONE) {
+      savedSTDIN_FILENO = dup(STDIN_FILENO);
+      Dup2(infd, STDIN_FILENO);
+    }
   }
   if (tok.outfile != NULL) {/* output redirected */
-    outfd = Open(tok.outfile, O_WRONLY|O_CREAT|O_TRUNC, 0);
-    savedSTDOUT_FILENO = dup(STDOUT_FILENO);
-    Dup2(outfd, STDOUT_FILENO);
+    outfd = Open(tok.outfile, O_WRONLY|O_CREAT|O_TRUNC|O_CLOEXEC, 0);
+    if (tok.builtins != BUILTIN_NONE) {
+      savedSTDOUT_FILENO = dup(STDOUT_FILENO);
+      Dup2(outfd, STDOUT_FILENO);
+    }
   }
   if (tok.builtins == BUILTIN_JOBS) {/* built in jobs command */
-    listjobs(job_list, STDOUT_FILENO);
+    listjobs(&job_list, STDOUT_FILENO);
     /* After listing jobs, restore file descriptors and close files */
     closeFileAndRestoreFd(&tok, infd, outfd, 
 			  savedSTDIN_FILENO, savedSTDOUT_FILENO);
     return;
   }
 
+  if (tok.builtins == BUILTIN_HASH) {/* built in hash command */
+    if (tok.argv[1] && !strcmp(tok.argv[1], "-r"))
+      forgetcommands(&path_cache, NULL);
+    else if (tok.argv[1])
+      fprintf(stderr, "hash: usage: hash [-r]\n");
+    else
+      listcommands(&path_cache, STDOUT_FILENO);
+    closeFileAndRestoreFd(&tok, infd, outfd, 
+			  savedSTDIN_FILENO, savedSTDOUT_FILENO);
+    return;
+  }
+
   /* Built in bg/fg command */
   if (tok.builtins == BUILTIN_BG || 
       tok.builtins == BUILTIN_FG) {
@@ -361,13 +605,13 @@ eval(char *cmdline)
 	      (tok.builtins == BUILTIN_BG) ? "bg" : "fg");
     } 
     else if ((pid = atoi(tok.argv[1])) > 0) {
-      job = getjobpid(job_list, pid);
+      job = getjobpid(&job_list, pid);
       if (job == NULL) {
 	fprintf(stderr, "(%d): No such process\n", pid);
       }
     } 
     else if (*(tok.argv[1]) == '%' && (jid = atoi(tok.argv[1]+1)) > 0) {
-      job = getjobjid(job_list, jid);
+      job = getjobjid(&job_list, jid);
       if (job == NULL) {
 	fprintf(stderr, "%%%d: No such job\n", jid);
       }
@@ -378,19 +622,18 @@ eval(char *cmdline)
     }
     /* If A vaid job is found, send a continue signal to that job */
     if (job && tok.builtins == BUILTIN_BG) {
-      job->state = BG;
       memset(sbuf, '\0', MAXLINE);
       sprintf(sbuf, "[%d] (%d) %s\n", job->jid, job->pid, job->cmdline);
       Write(STDOUT_FILENO, sbuf, strlen(sbuf));
-      Kill(job->pid, SIGCONT);
+      Sigprocmask(SIG_BLOCK, &mask_all, &mask_prev);
+      continuejob(&job_list, job, BG);
+      Sigprocmask(SIG_SETMASK, &mask_prev, NULL);
     } 
     else if (job && tok.builtins == BUILTIN_FG) {
-      job->state = FG;
-      Kill(job->pid, SIGCONT);
       /* Wait for job finish. Block all signals before using sigsuspend */
-      Sigprocmask(SIG_BLOCK, &mask_all, NULL);
-      while (fgpid(job_list))
-	sigsuspend(&mask_prev);
+      Sigprocmask(SIG_BLOCK, &mask_all, &mask_prev);
+      continuejob(&job_list, job, FG);
+      waitfg(&mask_prev);
       Sigprocmask(SIG_SETMASK, &mask_prev, NULL);
     }
     /* After finishing bg or fg, restore file descriptors and close files */
@@ -399,28 +642,46 @@ eval(char *cmdline)
     return;
   }
   
-  /* Block SIGCHLD before forking */
+  /* With -j, a background job waits for a free slot */
+  if (bg && maxbg > 0)
+    waitslot(maxbg);
+
+  /* Block SIGCHLD before spawning */
   Sigprocmask(SIG_BLOCK, &mask_child, &mask_prev);
   
-  pid_t pid = Fork();
-
-  /* Child runs user job */
-  if (pid == 0) {
-    Sigprocmask(SIG_SETMASK, &mask_prev, NULL);
-    /* Restore default handlers that are ignored by shell */
-    Signal(SIGTTIN, SIG_DFL);
-    Signal(SIGTTOU, SIG_DFL);
-    /* Put the child in a different process group */
-    Setpgid(0, 0);
-    if (execve(tok.argv[0], tok.argv, environ) < 0) {
-      fprintf(stderr, "%s: command not found\n", tok.argv[0]);
-      exit(1);
+  /* Spawn the stages of the pipeline into the group of the first, each
+     reading the pipe from the one before */
+  pid_t pids[MAXSTAGES];
+  int nprocs = 0, stage, fds[2];
+  int stagein = infd, stageout;
+  for (stage = 0; stage < tok.nstages; stage++) {
+    fds[0] = -1;
+    stageout = outfd;
+    if (stage < tok.nstages - 1) {
+      Pipe(fds);
+      stageout = fds[1];
     }
+    pid_t pid = spawnproc(tok.stages[stage], stagein, stageout, 
+			  nprocs ? pids[0] : 0, &job_mask);
+    if (pid)
+      pids[nprocs++] = pid;
+    if (stagein >= 0)
+      Close(stagein);
+    if (stageout >= 0 && stageout != outfd)
+      Close(stageout);
+    stagein = fds[0];
   }
+  if (outfd >= 0)
+    Close(outfd);
+  if (nprocs == 0) {
+    Sigprocmask(SIG_SETMASK, &mask_prev, NULL);
+    return;
+  }
+  pid_t pid = pids[0];
 
   /* Parent add job to the job list */
   Sigprocmask(SIG_BLOCK, &mask_all, NULL);
-  if (!addjob(job_list, pid, bg?BG:FG, cmdline))
+  if (!addjob(&job_list, pids, nprocs, bg?BG:FG, cmdline))
     app_error("add job error");
 
   /* Print job if it is background */
@@ -432,8 +693,7 @@ eval(char *cmdline)
  
   /* Shell wait for the foreground job send SIGCHLD */
   else {
-    while (fgpid(job_list))
-      sigsuspend(&mask_prev);
+    waitfg(&mask_prev);
     if (verbose) {
       memset(sbuf, '\0', MAXLINE);
       sprintf(sbuf, "Process (%d) no longer the fg process\n", pid);
@@ -441,25 +701,97 @@ eval(char *cmdline)
     }
   }
   Sigprocmask(SIG_SETMASK, &mask_prev, NULL);
-
-  /* Before return, close files and restore the file descriptors */
-  closeFileAndRestoreFd(&tok, infd, outfd, 
-			savedSTDIN_FILENO, savedSTDOUT_FILENO);
   return;
 }
 
+/*
+ * waitfg - Wait until there is no foreground job, with SIGCHLD, SIGINT
+ *     and SIGTSTP blocked. Their handlers run in sigsuspend with mask,
+ *     or from the event loop with -e.
+ */
+void 
+waitfg(sigset_t *mask) 
+{
+  sigset_t mask_wait;
+
+  if (sigfd >= 0) {
+    /* Only the signals read from sigfd, blocked in mask, stay blocked */
+    Sigprocmask(SIG_SETMASK, mask, &mask_wait);
+    while (fgpid(&job_list))
+      waitevents(0);
+    Sigprocmask(SIG_SETMASK, &mask_wait, NULL);
+    return;
+  }
+  while (fgpid(&job_list))
+    sigsuspend(mask);
+}
+
+/*
+ * waitslot - Wait until fewer than limit jobs run in background. Stopped
+ *     jobs do not count, they may never end.
+ */
+void 
+waitslot(int limit) 
+{
+  sigset_t mask_all, mask_prev;
+
+  if (sigfd >= 0) {
+    /* The signals read from sigfd are always blocked */
+    while (job_list.nbg >= limit)
+      waitevents(0);
+    return;
+  }
+  Sigfillset(&mask_all);
+  Sigprocmask(SIG_BLOCK, &mask_all, &mask_prev);
+  while (job_list.nbg >= limit)
+    sigsuspend(&mask_prev);
+  Sigprocmask(SIG_SETMASK, &mask_prev, NULL);
+}
+
+/*
+ * pipestage - Start the next command of the pipeline in tok at a '|',
+ *     returns 0 if the pipeline is malformed
+ */
+static int 
+pipestage(struct cmdline_tokens *tok, int parsing_state) 
+{
+    if (parsing_state != ST_NORMAL) {
+        (void) fprintf(stderr,
+                       "Error: must provide file name for redirection\n");
+        return 0;
+    }
+    if (tok->stages[tok->nstages-1] == &tok->argv[tok->argc]) {
+        (void) fprintf(stderr, "Error: missing command in pipeline\n");
+        return 0;
+    }
+    if (tok->outfile) {
+        /* Output of all but the last command goes to the pipe */
+        (void) fprintf(stderr, "Error: Ambiguous I/O redirection\n");
+        return 0;
+    }
+    if (tok->nstages >= MAXSTAGES || tok->argc >= MAXARGS-2) {
+        (void) fprintf(stderr, "Error: too many commands in pipeline\n");
+        return 0;
+    }
+    tok->argv[tok->argc++] = NULL;
+    tok->stages[tok->nstages++] = &tok->argv[tok->argc];
+    return 1;
+}
+
 /* 
  * parseline - Parse the command line and build the argv array.
  * 
  * Parameters:
  *   cmdline:  The command line, in the form:
  *
- *                command [arguments...] [< infile] [> oufile] [&]
+ *                command [arguments...] [< infile] 
+ *                    [| command [arguments...]]... [> oufile] [&]
  *
  *   tok:      Pointer to a cmdline_tokens structure. The elements of this
  *             structure will be populated with the parsed tokens. Characters 
  *             enclosed in single or double quotes are treated as a single
- *             argument. 
+ *             argument. The arguments of each command of the pipeline
+ *             are terminated by NULL in argv, and start at stages[i]. 
  * Returns:
  *   1:        if the user has requested a BG job
  *   0:        if the user has requested a FG job  
@@ -475,10 +807,12 @@ parseline(const char *cmdline, struct cmdline_tokens *tok)
 
     static char array[MAXLINE];          /* holds local copy of command line */
     const char delims[10] = " \t\r\n";   /* argument delimiters (white-space) */
+    const char pipedelims[10] = " \t\r\n|"; /* and for unquoted arguments */
     char *buf = array;                   /* ptr that traverses command line */
     char *next;                          /* ptr to the end of the current arg */
     char *endbuf;                        /* ptr to end of cmdline string */
     int is_bg;                           /* background job? */
+    int piped;                           /* argument ended by a '|'? */
 
     int parsing_state;                   /* indicates if the next token is the
                                             input or output file */
@@ -497,15 +831,26 @@ parseline(const char *cmdline, struct cmdline_tokens *tok)
     /* Build the argv list */
     parsing_state = ST_NORMAL;
     tok->argc = 0;
+    tok->nstages = 1;
+    tok->stages[0] = tok->argv;
 
     while (buf < endbuf) {
         /* Skip the white-spaces */
         buf += strspn (buf, delims);
         if (buf >= endbuf) break;
 
+        /* Check for pipes */
+        if (*buf == '|') {
+            if (!pipestage(tok, parsing_state))
+                return -1;
+            buf++;
+            continue;
+        }
+
         /* Check for I/O redirection specifiers */
         if (*buf == '<') {
-            if (tok->infile) {
+            /* Input of all but the first command comes from the pipe */
+            if (tok->infile || tok->nstages > 1) {
                 (void) fprintf(stderr, "Error: Ambiguous I/O redirection\n");
                 return -1;
             }
@@ -529,7 +874,7 @@ parseline(const char *cmdline, struct cmdline_tokens *tok)
             next = strchr (buf, *(buf-1));
         } else {
             /* Find next delimiter */
-            next = buf + strcspn (buf, delims);
+            next = buf + strcspn (buf, pipedelims);
         }
         
         if (next == NULL) {
@@ -540,6 +885,7 @@ parseline(const char *cmdline, struct cmdline_tokens *tok)
         }
 
         /* Terminate the token */
+        piped = (*next == '|');
         *next = '\0';
 
         /* Record the token as either the next argument or the i/o file */
@@ -562,6 +908,8 @@ parseline(const char *cmdline, struct cmdline_tokens *tok)
         /* Check if argv is full */
         if (tok->argc >= MAXARGS-1) break;
 
+        if (piped && !pipestage(tok, parsing_state))
+            return -1;
         buf = next + 1;
     }
 
@@ -577,6 +925,11 @@ parseline(const char *cmdline, struct cmdline_tokens *tok)
     if (tok->argc == 0)  /* ignore blank line */
         return 1;
 
+    if (tok->stages[tok->nstages-1] == &tok->argv[tok->argc]) {
+        (void) fprintf(stderr, "Error: missing command in pipeline\n");
+        return -1;
+    }
+
     if (!strcmp(tok->argv[0], "quit")) {                 /* quit command */
         tok->builtins = BUILTIN_QUIT;
     } else if (!strcmp(tok->argv[0], "jobs")) {          /* jobs command */
@@ -585,14 +938,29 @@ parseline(const char *cmdline, struct cmdline_tokens *tok)
         tok->builtins = BUILTIN_BG;
     } else if (!strcmp(tok->argv[0], "fg")) {            /* fg command */
         tok->builtins = BUILTIN_FG;
+    } else if (!strcmp(tok->argv[0], "hash")) {          /* hash command */
+        tok->builtins = BUILTIN_HASH;
     } else {
         tok->builtins = BUILTIN_NONE;
     }
 
+    /* Builtins run in the shell, not in a pipeline */
+    if (tok->builtins != BUILTIN_NONE && tok->nstages > 1) {
+        (void) fprintf(stderr, "Error: %s cannot be in a pipeline\n",
+                       tok->argv[0]);
+        return -1;
+    }
+
     /* Should the job run in the background? */
     if ((is_bg = (*tok->argv[tok->argc-1] == '&')) != 0)
         tok->argv[--tok->argc] = NULL;
 
+    if (tok->nstages > 1 && 
+        tok->stages[tok->nstages-1] == &tok->argv[tok->argc]) {
+        (void) fprintf(stderr, "Error: missing command in pipeline\n");
+        return -1;
+    }
+
     return is_bg;
 }
 
@@ -607,6 +975,9 @@ parseline(const char *cmdline, struct cmdline_tokens *tok)
  *     received a SIGSTOP, SIGTSTP, SIGTTIN or SIGTTOU signal. The 
  *     handler reaps all available zombie children, but doesn't wait 
  *     for any other currently running children to terminate.  
+ *     A pipeline is stopped once all of its processes are, and is done
+ *     once all of them terminated; like in other shells, whether it was
+ *     terminated by a signal is told by its last process.
  */
 void 
 sigchld_handler(int sig) 
@@ -627,39 +998,58 @@ sigchld_handler(int sig)
   while ((pid = waitpid(-1, &status, WNOHANG|WUNTRACED)) > 0) {
     Sigprocmask(SIG_BLOCK, &mask_all, &prev_all);
 
-    /* Get the job that triggered SIGCHLD */
-    struct job_t * job = getjobpid(job_list, pid);
+    /* Get the process and job that triggered SIGCHLD */
+    struct proc_t * proc = getprocpid(&job_list, pid);
+    struct job_t * job = proc->job;
     
     if (verbose && WIFEXITED(status)) {
       memset(sbuf, '\0', MAXLINE);
       sprintf(sbuf, "%s Job [%d] (%d) terminated OK (status %d)\n",
-	      msghdr, job->jid, job->pid, WEXITSTATUS(status));
-      Write(STDOUT_FILENO, sbuf, strlen(sbuf));
-    }
-    /* If terminate, print the signal that caused termination */
-    if (WIFSIGNALED(status)) {
-      memset(sbuf, '\0', MAXLINE);
-      sprintf(sbuf, "Job [%d] (%d) terminated by signal %d\n", 
-	      job->jid, job->pid, WTERMSIG(status));
+	      msghdr, job->jid, pid, WEXITSTATUS(status));
       Write(STDOUT_FILENO, sbuf, strlen(sbuf));
     }
-    /* If stop, print the signal that caused stop  */
     if (WIFSTOPPED(status)) {
-      memset(sbuf, '\0', MAXLINE);
-      sprintf(sbuf, "Job [%d] (%d) stopped by signal %d\n", 
-	      job->jid, job->pid, WSTOPSIG(status));
-      Write(STDOUT_FILENO, sbuf, strlen(sbuf));
-      job->state = ST;
-    }
-    else {
-      /* Unless the job is stopped, delete the job */
-      if (verbose) {
+      if (!proc->stopped) {
+	proc->stopped = 1;
+	job->running--;
+      }
+      /* Once the whole job stopped, print the signal that caused stop */
+      if (job->running == 0 && job->state != ST) {
 	memset(sbuf, '\0', MAXLINE);
-	sprintf(sbuf, "%s Job [%d] (%d) deleted\n", msghdr, job->jid, job->pid);
+	sprintf(sbuf, "Job [%d] (%d) stopped by signal %d\n", 
+		job->jid, job->pid, WSTOPSIG(status));
 	Write(STDOUT_FILENO, sbuf, strlen(sbuf));
+	setjobstate(&job_list, job, ST);
+      }
+    }
+    else {
+      if (proc == &job->procs[job->nprocs - 1])
+	job->status = status;
+      if (job->live > 1) {
+	/* Other processes of the pipeline are left */
+	reapproc(&job_list, proc);
+	if (job->running == 0 && job->state != ST)
+	  setjobstate(&job_list, job, ST);
+      }
+      else {
+	if (!WIFEXITED(job->status) || WEXITSTATUS(job->status) != 0)
+	  nfailed++;
+	/* If terminate, print the signal that caused termination */
+	if (WIFSIGNALED(job->status)) {
+	  memset(sbuf, '\0', MAXLINE);
+	  sprintf(sbuf, "Job [%d] (%d) terminated by signal %d\n", 
+		  job->jid, job->pid, WTERMSIG(job->status));
+	  Write(STDOUT_FILENO, sbuf, strlen(sbuf));
+	}
+	/* Unless the job is stopped, delete the job */
+	if (verbose) {
+	  memset(sbuf, '\0', MAXLINE);
+	  sprintf(sbuf, "%s Job [%d] (%d) deleted\n", msghdr, job->jid, job->pid);
+	  Write(STDOUT_FILENO, sbuf, strlen(sbuf));
+	}
+	if (!deletejob(&job_list, pid))
+	  app_error("delete job error");
       }
-      if (!deletejob(job_list, pid))
-	app_error("delete job error");
     }
 
     Sigprocmask(SIG_SETMASK, &prev_all, NULL);
@@ -689,7 +1079,7 @@ sigint_handler(int sig)
     sprintf(sbuf, "%s entering\n", msghdr);
     Write(STDOUT_FILENO, sbuf, strlen(sbuf));
   }
-  pid_t pid = fgpid(job_list);
+  pid_t pid = fgpid(&job_list);
   /* Send SIGINT only if there is foreground job */
   if (pid > 0) {
     Kill(-pid, SIGINT);
@@ -723,7 +1113,7 @@ sigtstp_handler(int sig)
     sprintf(sbuf, "%s entering\n", msghdr);
     Write(STDOUT_FILENO, sbuf, strlen(sbuf));
   }
-  pid_t pid = fgpid(job_list);
+  pid_t pid = fgpid(&job_list);
   /* Send SIGTSTP only if there is foreground job */
   if (pid > 0) {
     Kill(-pid, SIGTSTP);
@@ -746,6 +1136,107 @@ sigtstp_handler(int sig)
  * End signal handlers
  *********************/
 
+/*****************************************
+ * Event loop (-e)
+ *
+ * The signals the shell handles stay blocked and are read from sigfd,
+ * a signalfd, so their handlers run as ordinary functions between
+ * commands and never interrupt the shell. One SIGCHLD read reaps every
+ * child that changed state since the last one. The loop polls stdin
+ * for commands only while there is no foreground job, which may be
+ * reading the same terminal.
+ *****************************************/
+
+/*
+ * waitevents - Wait for a signal, or for input too if input is set,
+ *     and run the handlers of all pending signals. Returns 1 if there
+ *     is input to read.
+ */
+int 
+waitevents(int input) 
+{
+  struct pollfd fds[2];
+  struct signalfd_siginfo info[16];
+  ssize_t n;
+  int i, chld = 0;
+
+  fds[0].fd = sigfd;
+  fds[0].events = POLLIN;
+  fds[1].fd = cmdfd;
+  fds[1].events = POLLIN;
+  if (poll(fds, input ? 2 : 1, -1) < 0) {
+    if (errno == EINTR)
+      return 0;
+    unix_error("poll error");
+  }
+
+  if (fds[0].revents & POLLIN) {
+    while ((n = read(sigfd, info, sizeof(info))) > 0) {
+      for (i = 0; i < n / (ssize_t)sizeof(info[0]); i++) {
+	switch (info[i].ssi_signo) {
+	case SIGINT:
+	  sigint_handler(SIGINT);
+	  break;
+	case SIGTSTP:
+	  sigtstp_handler(SIGTSTP);
+	  break;
+	case SIGCHLD:
+	  chld = 1;
+	  break;
+	}
+      }
+    }
+    if (n < 0 && errno != EAGAIN && errno != EINTR)
+      unix_error("signalfd read error");
+    /* Reap once for all the SIGCHLDs */
+    if (chld)
+      sigchld_handler(SIGCHLD);
+  }
+  return input && (fds[1].revents & (POLLIN|POLLHUP|POLLERR));
+}
+
+/*
+ * readcmdline - Read the next line of commands into cmdline, handling
+ *     signals while waiting for it, like fgets into MAXLINE bytes. 
+ *     Returns 0 at the end of input.
+ */
+int 
+readcmdline(char *cmdline) 
+{
+  static char inbuf[MAXLINE];  /* input read past the last line */
+  static int inlen = 0;
+  static int ineof = 0;
+  char *nl;
+  ssize_t n;
+  int len;
+
+  while (1) {
+    nl = memchr(inbuf, '\n', inlen);
+    if (nl || inlen >= MAXLINE - 2 || (ineof && inlen > 0)) {
+      /* A line, a full buffer, or a last line without a newline */
+      len = nl ? nl - inbuf + 1 : (inlen < MAXLINE - 2 ? inlen : MAXLINE - 2);
+      memcpy(cmdline, inbuf, len);
+      inlen -= len;
+      memmove(inbuf, inbuf + len, inlen);
+      if (cmdline[len - 1] != '\n')
+	cmdline[len++] = '\n';
+      cmdline[len] = '\0';
+      return 1;
+    }
+    if (ineof)
+      return 0;
+    if (waitevents(1)) {
+      n = read(cmdfd, inbuf + inlen, sizeof(inbuf) - inlen);
+      if (n < 0 && errno != EINTR)
+	unix_error("read error");
+      if (n == 0)
+	ineof = 1;
+      else if (n > 0)
+	inlen += n;
+    }
+  }
+}
+
 /***********************************************
  * Helper routines that manipulate the job list
  **********************************************/
@@ -757,176 +1248,516 @@ clearjob(struct job_t *job) {
     job->jid = 0;
     job->state = UNDEF;
     job->cmdline[0] = '\0';
+    job->nprocs = job->live = job->running = 0;
+    job->status = 0;
+    job->next = NULL;
+}
+
+/* pidbucket - The PID hash bucket of pid */
+static struct proc_t 
+**pidbucket(struct job_list_t *job_list, pid_t pid) {
+    return &job_list->buckets[((unsigned)pid * 2654435761U) & 
+                              (job_list->nbuckets - 1)];
 }
 
 /* initjobs - Initialize the job list */
 void 
-initjobs(struct job_t *job_list) {
-    int i;
-
-    for (i = 0; i < MAXJOBS; i++)
-        clearjob(&job_list[i]);
+initjobs(struct job_list_t *job_list) {
+    job_list->nbuckets = MINBUCKETS;
+    job_list->buckets = calloc(MINBUCKETS, sizeof(struct proc_t *));
+    job_list->nprocs = 0;
+    job_list->njids = MINBUCKETS;
+    job_list->jids = calloc(MINBUCKETS, sizeof(struct job_t *));
+    if (job_list->buckets == NULL || job_list->jids == NULL)
+        unix_error("initjobs error");
+    job_list->njobs = 0;
+    job_list->nbg = 0;
+    job_list->maxjid = 0;
+    job_list->fg = NULL;
+    job_list->free = NULL;
 }
 
 /* maxjid - Returns largest allocated job ID */
 int 
-maxjid(struct job_t *job_list) 
+maxjid(struct job_list_t *job_list) 
 {
-    int i, max=0;
-
-    for (i = 0; i < MAXJOBS; i++)
-        if (job_list[i].jid > max)
-            max = job_list[i].jid;
-    return max;
+    return job_list->maxjid;
 }
 
-/* addjob - Add a job to the job list */
-int 
-addjob(struct job_t *job_list, pid_t pid, int state, char *cmdline) 
+/* growjobs - Make room for a job of nprocs, returns 0 if out of memory */
+static int 
+growjobs(struct job_list_t *job_list, int nprocs) 
 {
     int i;
 
-    if (pid < 1)
-        return 0;
-
-    for (i = 0; i < MAXJOBS; i++) {
-        if (job_list[i].pid == 0) {
-            job_list[i].pid = pid;
-            job_list[i].state = state;
-            job_list[i].jid = nextjid++;
-            if (nextjid > MAXJOBS)
-                nextjid = 1;
-            strcpy(job_list[i].cmdline, cmdline);
-            if(verbose){
-                printf("Added job [%d] %d %s\n",
-                       job_list[i].jid,
-                       job_list[i].pid,
-                       job_list[i].cmdline);
+    /* Keep the PID hash at most fully loaded */
+    if (job_list->nprocs + nprocs > job_list->nbuckets) {
+        struct proc_t **old = job_list->buckets;
+        int nold = job_list->nbuckets, nnew = nold;
+        struct proc_t **buckets;
+
+        while (job_list->nprocs + nprocs > nnew)
+            nnew *= 2;
+        if ((buckets = calloc(nnew, sizeof(struct proc_t *))) == NULL)
+            return 0;
+        job_list->buckets = buckets;
+        job_list->nbuckets = nnew;
+        for (i = 0; i < nold; i++) {
+            while (old[i]) {
+                struct proc_t *proc = old[i], **bucket;
+
+                old[i] = proc->next;
+                bucket = pidbucket(job_list, proc->pid);
+                proc->next = *bucket;
+                *bucket = proc;
             }
-            return 1;
         }
+        free(old);
     }
-    printf("Tried to create too many jobs\n");
-    return 0;
+
+    /* The next job gets JID maxjid+1 */
+    if (job_list->maxjid + 1 >= job_list->njids) {
+        struct job_t **jids = realloc(job_list->jids, 
+                                      2 * job_list->njids * sizeof(struct job_t *));
+
+        if (jids == NULL)
+            return 0;
+        memset(jids + job_list->njids, 0, 
+               job_list->njids * sizeof(struct job_t *));
+        job_list->jids = jids;
+        job_list->njids *= 2;
+    }
+
+    if (job_list->free == NULL) {
+        struct job_t *job = malloc(sizeof(struct job_t));
+
+        if (job == NULL)
+            return 0;
+        clearjob(job);
+        job_list->free = job;
+    }
+    return 1;
 }
 
-/* deletejob - Delete a job whose PID=pid from the job list */
+/* 
+ * addjob - Add a job of the nprocs processes pids to the job list, the
+ *     first of them leads the process group. May allocate, so it must not
+ *     be called from a signal handler, and signals must be blocked.
+ */
 int 
-deletejob(struct job_t *job_list, pid_t pid) 
+addjob(struct job_list_t *job_list, pid_t *pids, int nprocs, int state, 
+       char *cmdline) 
 {
+    struct job_t *job;
     int i;
 
-    if (pid < 1)
+    if (nprocs < 1 || nprocs > MAXSTAGES || pids[0] < 1)
         return 0;
+    if (!growjobs(job_list, nprocs)) {
+        printf("Tried to create too many jobs\n");
+        return 0;
+    }
+
+    job = job_list->free;
+    job_list->free = job->next;
+    job->pid = pids[0];
+    job->state = state;
+    job->jid = job_list->maxjid + 1;
+    strcpy(job->cmdline, cmdline);
+    job->nprocs = job->live = job->running = nprocs;
+    job->status = 0;
+    job->next = NULL;
+    for (i = 0; i < nprocs; i++) {
+        struct proc_t *proc = &job->procs[i], **bucket;
+
+        proc->pid = pids[i];
+        proc->stopped = 0;
+        proc->job = job;
+        bucket = pidbucket(job_list, pids[i]);
+        proc->next = *bucket;
+        *bucket = proc;
+    }
+    job_list->nprocs += nprocs;
+    job_list->jids[job->jid] = job;
+    job_list->maxjid = job->jid;
+    job_list->njobs++;
+    if (state == FG)
+        job_list->fg = job;
+    if (state == BG)
+        job_list->nbg++;
+    nextjid = job_list->maxjid + 1;
+    if(verbose){
+        printf("Added job [%d] %d %s\n",
+               job->jid,
+               job->pid,
+               job->cmdline);
+    }
+    return 1;
+}
 
-    for (i = 0; i < MAXJOBS; i++) {
-        if (job_list[i].pid == pid) {
-            clearjob(&job_list[i]);
-            nextjid = maxjid(job_list)+1;
-            return 1;
+/* unlinkproc - Remove proc from the PID hash, if it is there */
+static void 
+unlinkproc(struct job_list_t *job_list, struct proc_t *proc) 
+{
+    struct proc_t **link;
+
+    for (link = pidbucket(job_list, proc->pid); *link; link = &(*link)->next) {
+        if (*link == proc) {
+            *link = proc->next;
+            proc->next = NULL;
+            job_list->nprocs--;
+            return;
         }
     }
-    return 0;
 }
 
-/* fgpid - Return PID of current foreground job, 0 if no such job */
-pid_t 
-fgpid(struct job_t *job_list) {
+/* 
+ * reapproc - Account a process of a job that terminated. Its PID may be
+ *     reused at once, so it leaves the PID hash now; its job stays until
+ *     deletejob. Async-signal-safe.
+ */
+void 
+reapproc(struct job_list_t *job_list, struct proc_t *proc) 
+{
+    struct job_t *job = proc->job;
+
+    unlinkproc(job_list, proc);
+    job->live--;
+    if (!proc->stopped)
+        job->running--;
+    proc->pid = 0;
+}
+
+/* 
+ * deletejob - Delete the job with a process whose PID=pid from the job
+ *     list. Async-signal-safe: the job goes on the free list.
+ */
+int 
+deletejob(struct job_list_t *job_list, pid_t pid) 
+{
+    struct proc_t *proc = getprocpid(job_list, pid);
+    struct job_t *job;
     int i;
 
-    for (i = 0; i < MAXJOBS; i++)
-        if (job_list[i].state == FG)
-            return job_list[i].pid;
-    return 0;
+    if (proc == NULL)
+        return 0;
+    job = proc->job;
+    for (i = 0; i < job->nprocs; i++)
+        if (job->procs[i].pid)
+            unlinkproc(job_list, &job->procs[i]);
+    job_list->jids[job->jid] = NULL;
+    if (job_list->fg == job)
+        job_list->fg = NULL;
+    if (job->state == BG)
+        job_list->nbg--;
+    /* Each step down was a step up when a job was added */
+    while (job_list->maxjid > 0 && 
+           job_list->jids[job_list->maxjid] == NULL)
+        job_list->maxjid--;
+    nextjid = job_list->maxjid + 1;
+    job_list->njobs--;
+    clearjob(job);
+    job->next = job_list->free;
+    job_list->free = job;
+    return 1;
 }
 
-/* getjobpid  - Find a job (by PID) on the job list */
-struct job_t 
-*getjobpid(struct job_t *job_list, pid_t pid) {
+/* 
+ * setjobstate - Change the state of a job, tracking the foreground job
+ *     and the count of background jobs
+ */
+void 
+setjobstate(struct job_list_t *job_list, struct job_t *job, int state) 
+{
+    if (job_list->fg == job)
+        job_list->fg = NULL;
+    if (job->state == BG)
+        job_list->nbg--;
+    job->state = state;
+    if (state == FG)
+        job_list->fg = job;
+    if (state == BG)
+        job_list->nbg++;
+}
+
+/* continuejob - Send SIGCONT to the process group of a job, now in state */
+void 
+continuejob(struct job_list_t *job_list, struct job_t *job, int state) 
+{
     int i;
 
+    for (i = 0; i < job->nprocs; i++)
+        job->procs[i].stopped = 0;
+    job->running = job->live;
+    setjobstate(job_list, job, state);
+    Kill(-job->pid, SIGCONT);
+}
+
+/* fgpid - Return PID of current foreground job, 0 if no such job */
+pid_t 
+fgpid(struct job_list_t *job_list) {
+    return job_list->fg ? job_list->fg->pid : 0;
+}
+
+/* getprocpid - Find a process of a job (by PID) */
+struct proc_t 
+*getprocpid(struct job_list_t *job_list, pid_t pid) {
+    struct proc_t *proc;
+
     if (pid < 1)
         return NULL;
-    for (i = 0; i < MAXJOBS; i++)
-        if (job_list[i].pid == pid)
-            return &job_list[i];
+    for (proc = *pidbucket(job_list, pid); proc; proc = proc->next)
+        if (proc->pid == pid)
+            return proc;
     return NULL;
 }
 
+/* getjobpid  - Find a job (by the PID of any of its processes) */
+struct job_t 
+*getjobpid(struct job_list_t *job_list, pid_t pid) {
+    struct proc_t *proc = getprocpid(job_list, pid);
+
+    return proc ? proc->job : NULL;
+}
+
 /* getjobjid  - Find a job (by JID) on the job list */
-struct job_t *getjobjid(struct job_t *job_list, int jid) 
+struct job_t *getjobjid(struct job_list_t *job_list, int jid) 
 {
-    int i;
-
-    if (jid < 1)
+    if (jid < 1 || jid > job_list->maxjid)
         return NULL;
-    for (i = 0; i < MAXJOBS; i++)
-        if (job_list[i].jid == jid)
-            return &job_list[i];
-    return NULL;
+    return job_list->jids[jid];
 }
 
 /* pid2jid - Map process ID to job ID */
 int 
 pid2jid(pid_t pid) 
+{
+    struct job_t *job = getjobpid(&job_list, pid);
+
+    return job ? job->jid : 0;
+}
+/* listjobs - Print the job list, in JID order */
+void 
+listjobs(struct job_list_t *job_list, int output_fd) 
 {
     int i;
+    char buf[MAXLINE + 1];
+    struct job_t *job;
 
-    if (pid < 1)
-        return 0;
-    for (i = 0; i < MAXJOBS; i++)
-        if (job_list[i].pid == pid) {
-            return job_list[i].jid;
+    for (i = 1; i <= job_list->maxjid; i++) {
+        if ((job = job_list->jids[i]) == NULL)
+            continue;
+        memset(buf, '\0', sizeof(buf));
+        sprintf(buf, "[%d] (%d) ", job->jid, job->pid);
+        if(write(output_fd, buf, strlen(buf)) < 0) {
+            fprintf(stderr, "Error writing to output file\n");
+            exit(1);
         }
-    return 0;
+        memset(buf, '\0', sizeof(buf));
+        switch (job->state) {
+        case BG:
+            sprintf(buf, "Running    ");
+            break;
+        case FG:
+            sprintf(buf, "Foreground ");
+            break;
+        case ST:
+            sprintf(buf, "Stopped    ");
+            break;
+        default:
+            sprintf(buf, "listjobs: Internal error: job[%d].state=%d ",
+                    i, job->state);
+        }
+        if(write(output_fd, buf, strlen(buf)) < 0) {
+            fprintf(stderr, "Error writing to output file\n");
+            exit(1);
+        }
+        memset(buf, '\0', sizeof(buf));
+        sprintf(buf, "%s\n", job->cmdline);
+        if(write(output_fd, buf, strlen(buf)) < 0) {
+            fprintf(stderr, "Error writing to output file\n");
+            exit(1);
+        }
+    }
+}
+/******************************
+ * end job list helper routines
+ ******************************/
+
+
+/*************************************************
+ * Helper routines that manipulate the command cache
+ *************************************************/
+
+/* namehash - FNV-1a hash of a command name */
+static unsigned 
+namehash(const char *name) 
+{
+    unsigned h = 2166136261U;
+
+    while (*name)
+        h = (h ^ (unsigned char)*name++) * 16777619U;
+    return h;
+}
+
+/* searchpath - Return the path of name in PATH in a malloc'ed string,
+   NULL if it is in none of its directories */
+static char 
+*searchpath(const char *name, const char *path) 
+{
+    size_t len = strlen(name);
+    const char *dir = path, *end;
+    struct stat st;
+
+    while (1) {
+        size_t dirlen;
+        char *file;
+
+        end = strchr(dir, ':');
+        dirlen = end ? (size_t)(end - dir) : strlen(dir);
+        /* An empty entry is the current directory */
+        if ((file = malloc(dirlen + len + 3)) == NULL)
+            return NULL;
+        if (dirlen == 0)
+            strcpy(file, ".");
+        else {
+            memcpy(file, dir, dirlen);
+            file[dirlen] = '\0';
+        }
+        strcat(file, "/");
+        strcat(file, name);
+        if (stat(file, &st) == 0 && S_ISREG(st.st_mode) && 
+            access(file, X_OK) == 0)
+            return file;
+        free(file);
+        if (end == NULL)
+            return NULL;
+        dir = end + 1;
+    }
 }
 
-/* listjobs - Print the job list */
+/* 
+ * findcommand - Return the path to run the command name from: name itself
+ *     if it has a '/', else where it is in PATH, NULL if it is nowhere.
+ *     Paths found are remembered until PATH changes.
+ */
+const char 
+*findcommand(struct path_cache_t *cache, const char *name) 
+{
+    const char *path = getenv("PATH");
+    struct pathent_t *ent, **bucket;
+    char *file;
+
+    if (strchr(name, '/'))
+        return name;
+    if (path == NULL)
+        path = "/bin:/usr/bin";
+    if (cache->path == NULL || strcmp(cache->path, path) != 0) {
+        forgetcommands(cache, NULL);
+        free(cache->path);
+        if ((cache->path = strdup(path)) == NULL)
+            unix_error("findcommand error");
+    }
+    if (cache->nbuckets == 0) {
+        cache->nbuckets = MINBUCKETS;
+        cache->buckets = calloc(MINBUCKETS, sizeof(struct pathent_t *));
+        if (cache->buckets == NULL)
+            unix_error("findcommand error");
+    }
+
+    bucket = &cache->buckets[namehash(name) & (cache->nbuckets - 1)];
+    for (ent = *bucket; ent; ent = ent->next) {
+        if (!strcmp(ent->name, name)) {
+            ent->hits++;
+            return ent->path;
+        }
+    }
+    if ((file = searchpath(name, path)) == NULL)
+        return NULL;
+
+    /* Keep the table at most fully loaded */
+    if (cache->nentries + 1 > cache->nbuckets) {
+        struct pathent_t **old = cache->buckets;
+        int i, nold = cache->nbuckets;
+
+        cache->buckets = calloc(2 * nold, sizeof(struct pathent_t *));
+        if (cache->buckets == NULL)
+            unix_error("findcommand error");
+        cache->nbuckets = 2 * nold;
+        for (i = 0; i < nold; i++) {
+            while ((ent = old[i]) != NULL) {
+                old[i] = ent->next;
+                bucket = &cache->buckets[namehash(ent->name) & 
+                                         (cache->nbuckets - 1)];
+                ent->next = *bucket;
+                *bucket = ent;
+            }
+        }
+        free(old);
+        bucket = &cache->buckets[namehash(name) & (cache->nbuckets - 1)];
+    }
+    if ((ent = malloc(sizeof(struct pathent_t))) == NULL || 
+        (ent->name = strdup(name)) == NULL)
+        unix_error("findcommand error");
+    ent->path = file;
+    ent->hits = 1;
+    ent->next = *bucket;
+    *bucket = ent;
+    cache->nentries++;
+    return ent->path;
+}
+
+/* forgetcommands - Forget the path of name, or of every command if NULL */
 void 
-listjobs(struct job_t *job_list, int output_fd) 
+forgetcommands(struct path_cache_t *cache, const char *name) 
 {
+    struct pathent_t **link, *ent;
     int i;
-    char buf[MAXLINE];
 
-    for (i = 0; i < MAXJOBS; i++) {
-        memset(buf, '\0', MAXLINE);
-        if (job_list[i].pid != 0) {
-            sprintf(buf, "[%d] (%d) ", job_list[i].jid, job_list[i].pid);
-            if(write(output_fd, buf, strlen(buf)) < 0) {
-                fprintf(stderr, "Error writing to output file\n");
-                exit(1);
-            }
-            memset(buf, '\0', MAXLINE);
-            switch (job_list[i].state) {
-            case BG:
-                sprintf(buf, "Running    ");
-                break;
-            case FG:
-                sprintf(buf, "Foreground ");
-                break;
-            case ST:
-                sprintf(buf, "Stopped    ");
-                break;
-            default:
-                sprintf(buf, "listjobs: Internal error: job[%d].state=%d ",
-                        i, job_list[i].state);
-            }
-            if(write(output_fd, buf, strlen(buf)) < 0) {
-                fprintf(stderr, "Error writing to output file\n");
-                exit(1);
-            }
-            memset(buf, '\0', MAXLINE);
-            sprintf(buf, "%s\n", job_list[i].cmdline);
-            if(write(output_fd, buf, strlen(buf)) < 0) {
-                fprintf(stderr, "Error writing to output file\n");
-                exit(1);
+    for (i = 0; i < cache->nbuckets; i++) {
+        link = &cache->buckets[i];
+        while ((ent = *link) != NULL) {
+            if (name && strcmp(ent->name, name) != 0) {
+                link = &ent->next;
+                continue;
             }
+            *link = ent->next;
+            free(ent->name);
+            free(ent->path);
+            free(ent);
+            cache->nentries--;
         }
     }
 }
-/******************************
- * end job list helper routines
- ******************************/
+
+/* listcommands - Print the remembered commands, as bash's hash does */
+void 
+listcommands(struct path_cache_t *cache, int output_fd) 
+{
+    struct pathent_t *ent;
+    char buf[MAXLINE];
+    int i;
+
+    if (cache->nentries == 0) {
+        strcpy(buf, "hash: hash table empty\n");
+        if (write(output_fd, buf, strlen(buf)) < 0)
+            unix_error("listcommands error");
+        return;
+    }
+    strcpy(buf, "hits\tcommand\n");
+    if (write(output_fd, buf, strlen(buf)) < 0)
+        unix_error("listcommands error");
+    for (i = 0; i < cache->nbuckets; i++) {
+        for (ent = cache->buckets[i]; ent; ent = ent->next) {
+            snprintf(buf, MAXLINE, "%4d\t%s\n", ent->hits, ent->path);
+            if (write(output_fd, buf, strlen(buf)) < 0)
+                unix_error("listcommands error");
+        }
+    }
+}
+/***********************************
+ * end command cache helper routines
+ ***********************************/
 
 
 /***********************
@@ -939,10 +1770,13 @@ listjobs(struct job_t *job_list, int output_fd)
 void 
 usage(void) 
 {
-    printf("Usage: shell [-hvp]\n");
+    printf("Usage: shell [-hvpe] [-j <jobs>] [script]\n");
     printf("   -h   print this message\n");
     printf("   -v   print additional diagnostic information\n");
     printf("   -p   do not emit a command prompt\n");
+    printf("   -e   handle signals in an event loop on a signalfd\n");
+    printf("   -j   run at most <jobs> jobs in background at a time\n");
+    printf("   script  run the commands of this file, without a prompt\n");
     exit(1);
 }
 
@@ -956,6 +1790,17 @@ unix_error(char *msg)
     exit(1);
 }
 
+/*
+ * posix_error - posix-style error routine, for calls that return
+ *     the error code instead of setting errno
+ */
+void 
+posix_error(int code, char *msg)
+{
+    fprintf(stdout, "%s: %s\n", msg, strerror(code));
+    exit(1);
+}
+
 /*
  * app_error - application-style error routine
  */